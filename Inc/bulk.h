@@ -0,0 +1,23 @@
+#ifndef __BULK_H
+#define __BULK_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "uart_dma.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define BULK_PACKET_SIZE    64      /* wMaxPacketSize of the bulk IN endpoint (full speed) */
+
+/* Exported functions --------------------------------------------------------*/
+void Bulk_Init(void);
+void Bulk_Forward(UART_DMA_t* ch);
+void Bulk_TxCplt(uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BULK_H */
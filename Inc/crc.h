@@ -0,0 +1,42 @@
+#ifndef __CRC_H
+#define __CRC_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Defines -------------------------------------------------------------------*/
+/* Supported CRCs (both reflected, the check sequence is sent LSB first as in HDLC) */
+#define CRC_16              16      /* CRC-16/X.25 (HDLC FCS-16): 0x1021, init 0xFFFF, final XOR 0xFFFF */
+#define CRC_32              32      /* CRC-32 (IEEE 802.3, HDLC FCS-32): 0x04C11DB7, init 0xFFFFFFFF, final XOR 0xFFFFFFFF */
+
+/* Register value after the data and its check sequence, if the data is intact */
+#define CRC_16_GOOD         0xF0B8U
+#define CRC_32_GOOD         0xDEBB20E3U
+
+/* Type definitions ----------------------------------------------------------*/
+/* Running CRC
+ * Note: value is the reflected CRC register before the final XOR. A computation can be continued
+ *       at any time, thus several computations can be interleaved on the single CRC peripheral.
+*/
+typedef struct
+{
+    uint32_t value;             /* CRC register */
+    uint8_t  width;             /* CRC_16 or CRC_32 */
+} Crc_t;
+
+/* Exported functions --------------------------------------------------------*/
+void Crc_Init(void);
+void Crc_Start(Crc_t* c, uint8_t width);
+void Crc_Update(Crc_t* c, const uint8_t* data, uint32_t len);
+uint32_t Crc_Final(const Crc_t* c);
+uint8_t Crc_IsGood(const Crc_t* c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CRC_H */
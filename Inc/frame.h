@@ -0,0 +1,47 @@
+#ifndef __FRAME_H
+#define __FRAME_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "main.h"
+#include "crc.h"
+
+/* Defines -------------------------------------------------------------------*/
+/* Frame_Decode() results */
+#define FRAME_MORE          0       /* All input consumed, the frame is not complete yet */
+#define FRAME_DONE          1       /* Frame complete: buf[0..len) */
+#define FRAME_ERROR         2       /* Frame dropped: encoding error, abort sequence or longer than the buffer */
+#define FRAME_BAD_FCS       3       /* Frame complete with invalid check sequence: buf[0..len) */
+
+/* Type definitions ----------------------------------------------------------*/
+/* Streaming frame decoder
+ * Note: the decoded frame is written to buf. The buffer may be changed between the frames
+ *       (after FRAME_DONE, FRAME_ERROR or FRAME_BAD_FCS), e.g. while the previous frame is being sent.
+*/
+typedef struct
+{
+    uint8_t* buf;               /* Decoded frame */
+    uint16_t size;              /* Buffer size: longest frame */
+    uint16_t len;               /* Decoded bytes of the current frame */
+    uint8_t  codec;             /* FRAME_COBS, FRAME_SLIP or FRAME_HDLC */
+    uint8_t  state;             /* Decoder state */
+    uint8_t  code;              /* COBS: code byte of the current block, 0 at frame start */
+    uint8_t  left;              /* COBS: data bytes left in the current block */
+    uint8_t  fcs;               /* Check sequence length in bytes, 0: frames without CRC */
+    uint16_t checked;           /* Decoded bytes added to the CRC */
+    Crc_t    crc;               /* CRC of the current frame */
+} Frame_t;
+
+/* Exported functions --------------------------------------------------------*/
+void Frame_Init(Frame_t* f, uint8_t codec, uint8_t crc, uint8_t* buf, uint16_t size);
+uint8_t Frame_Decode(Frame_t* f, const uint8_t* data, uint32_t len, uint32_t* used);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FRAME_H */
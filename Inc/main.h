@@ -6,11 +6,48 @@
 
 
 /* Configuration **************************************************************/
-#define DMA_BUF_SIZE        64      /* DMA circular buffer size in bytes */
-#define DMA_TIMEOUT_MS      10      /* DMA Timeout duration in msec */
+#define UART_BAUDRATE       115200  /* UART baud rate in bits/sec */
+#define DMA_BUF_SIZE        64      /* DMA circular buffer size in bytes, power of two up to 32768 */
+#define DMA_HT_ENABLE       0       /* 1: process DMA buffer on Half Transfer IT as well, 0: disable Half Transfer IT */
+#define DMA_TIMEOUT_ENGINE  DMA_TIMEOUT_SYSTICK     /* DMA Timeout source: DMA_TIMEOUT_SYSTICK or DMA_TIMEOUT_RTO */
+#define DMA_TIMEOUT_MS      10      /* DMA Timeout duration in msec (SysTick engine) */
+#define DMA_TIMEOUT_BITS    ((UART_BAUDRATE / 1000) * DMA_TIMEOUT_MS)   /* DMA Timeout duration in bit-times (RTO engine) */
+#define DMA_ADAPT_ENABLE    0       /* 1: adapt the DMA Timeout to the measured gaps between the bursts, 0: fixed DMA Timeout */
+#define DMA_ADAPT_MIN_BITS  20      /* Shortest adaptive DMA Timeout in bit-times */
+#define DMA_ADAPT_MAX_BITS  (DMA_TIMEOUT_BITS * 4)  /* Longest adaptive DMA Timeout in bit-times */
+#define UART_ERROR_MARK     0       /* 1: replace characters received with parity, framing or noise error by UART_ERROR_MARKER, 0: such characters are discarded */
+#define UART_ERROR_MARKER   0xFF    /* Error mark character, also fills the DMA lap interrupted by a DMA transfer error */
+#define STATS_ENABLE        1       /* 1: collect RX path statistics (stats.c), 0: disable instrumentation */
+#define DMA_M2M_ENABLE      0       /* 1: copy large chunks out of the DMA buffer with memory-to-memory DMA (UART_DMA_ReadAsync), 0: CPU copy only */
+#define DMA_M2M_THRESHOLD   256     /* Minimum chunk size in bytes for memory-to-memory DMA */
+#define UART_TX_BUF_SIZE    256     /* UART TX ring size in bytes (USB to UART direction), power of two, at least two USB packets */
+#define DMA_MATCH_ENABLE    0       /* 1: flush received data as soon as DMA_MATCH_CHAR arrives (UART character match IT), 0: disable */
+#define DMA_MATCH_CHAR      '\n'    /* Terminator character of the flush on terminator mode and of the line forwarding */
+#define USB_LINE_ENABLE     0       /* 1: forward every line terminated by DMA_MATCH_CHAR as one USB transfer (raw forwarding only), 0: forward the data as received */
+#define FRAME_CODEC         FRAME_NONE  /* Framing stage between UART RX and USB: FRAME_NONE (raw forwarding), FRAME_COBS, FRAME_SLIP or FRAME_HDLC */
+#define FRAME_MAX_SIZE      256     /* Longest decoded frame in bytes, longer frames are dropped (framing stage) */
+#define FRAME_CRC           0       /* Check sequence at the end of each frame: 0 (none), 16 (CRC-16/X.25) or 32 (CRC-32), verified and removed */
+#define FRAME_CRC_DROP      1       /* 1: drop frames with invalid check sequence, 0: forward them, a status byte (0x00 intact, 0x01 invalid) ends every frame */
+#define UART_DMA_STAMP      0       /* 1: stamp every received chunk with its arrival time (DWT cycle counter), sent in a record header ahead of the data over USB (raw forwarding only), 0: disable */
+#define STAMP_RECORD_SIZE   256     /* Timestamped record size in bytes (header and data), longer chunks are split into several records */
+#define USB_CDC_PORTS       1       /* Bridged serial ports, one CDC ACM function each: 1 (USART2) or 2 (USART2 and USB_CDC_PORT2_UART, composite device, raw forwarding only) */
+#define USB_CDC_PORT2_UART  UART_DMA_USART1     /* Serial port of the second CDC function */
+#define USB_BULK_ENABLE     0       /* 1: stream the data received on USART2 over a vendor-specific bulk IN interface instead of the CDC data IN endpoint (raw capture, raw forwarding and DMA_HT_ENABLE only), 0: disable */
+#define USB_BULK_XFER_SIZE  4096    /* Largest bulk transfer in bytes, multiple of the 64-byte packet size */
 /******************************************************************************/
 
 
+/* DMA Timeout engines */
+#define DMA_TIMEOUT_SYSTICK 0       /* UART IDLE interrupt + SysTick software timer, 1 msec resolution */
+#define DMA_TIMEOUT_RTO     1       /* UART hardware receiver timeout (RTOR), 1 bit-time resolution */
+
+/* Framing codecs */
+#define FRAME_NONE          0       /* No framing: received data is forwarded as is */
+#define FRAME_COBS          1       /* Consistent Overhead Byte Stuffing, frames terminated by 0x00 */
+#define FRAME_SLIP          2       /* SLIP (RFC 1055), frames terminated by 0xC0 */
+#define FRAME_HDLC          3       /* HDLC-like byte stuffing (RFC 1662), frames delimited by 0x7E */
+
+
 /* Defines -------------------------------------------------------------------*/
 #define LED_G_Port          GPIOE
 #define LED_G_Pin           GPIO_PIN_8
@@ -24,19 +61,85 @@
 #define LED_R_OFF()         HAL_GPIO_WritePin(LED_R_Port, LED_R_Pin, GPIO_PIN_RESET);
 #define LED_R_TG()          HAL_GPIO_TogglePin(LED_R_Port, LED_R_Pin);
 
-/* Type definitions ----------------------------------------------------------*/
-typedef struct
-{
-    volatile uint8_t  flag;     /* Timeout event flag */
-    uint16_t timer;             /* Timeout duration in msec */
-    uint16_t prevCNDTR;         /* Holds previous value of DMA_CNDTR */
-} DMA_Event_t;
-
 /* Functions -----------------------------------------------------------------*/
-void UART_Init(void);
-void DMA_Init(void);
 void GPIO_Init(void);
 void SystemClock_Config(void);
 void Error_Handler(void);
 
+#if (DMA_TIMEOUT_ENGINE == DMA_TIMEOUT_RTO) && ((DMA_TIMEOUT_BITS == 0) || (DMA_TIMEOUT_BITS > 0xFFFFFF))
+#error "DMA_TIMEOUT_BITS must fit into the 24-bit RTOR.RTO field"
+#endif
+
+#if (DMA_ADAPT_ENABLE == 1) && ((DMA_ADAPT_MIN_BITS == 0) || (DMA_ADAPT_MIN_BITS > DMA_ADAPT_MAX_BITS) || (DMA_ADAPT_MAX_BITS > 0xFFFFFF))
+#error "DMA_ADAPT_MIN_BITS and DMA_ADAPT_MAX_BITS must be an increasing range within the 24-bit RTOR.RTO field"
+#endif
+
+#if (UART_ERROR_MARKER < 0) || (UART_ERROR_MARKER > 0xFF)
+#error "UART_ERROR_MARKER must be an 8-bit character"
+#endif
+
+#if (DMA_BUF_SIZE < 2) || (DMA_BUF_SIZE > 32768) || (DMA_BUF_SIZE & (DMA_BUF_SIZE - 1))
+#error "DMA_BUF_SIZE must be a power of two between 2 and 32768"
+#endif
+
+#if (DMA_M2M_ENABLE == 1) && (DMA_M2M_THRESHOLD == 0)
+#error "DMA_M2M_THRESHOLD must be at least 1"
+#endif
+
+#if ((DMA_MATCH_ENABLE == 1) || (USB_LINE_ENABLE == 1)) && ((DMA_MATCH_CHAR < 0) || (DMA_MATCH_CHAR > 0xFF))
+#error "DMA_MATCH_CHAR must be an 8-bit character"
+#endif
+
+#if (USB_LINE_ENABLE == 1) && ((FRAME_CODEC != FRAME_NONE) || (UART_DMA_STAMP == 1))
+#error "USB_LINE_ENABLE requires raw forwarding (FRAME_CODEC = FRAME_NONE, UART_DMA_STAMP = 0)"
+#endif
+
+#if (FRAME_CODEC != FRAME_NONE) && ((FRAME_MAX_SIZE == 0) || (FRAME_MAX_SIZE > 0xFFFF))
+#error "FRAME_MAX_SIZE must be between 1 and 65535"
+#endif
+
+#if (FRAME_CRC != 0) && (FRAME_CRC != 16) && (FRAME_CRC != 32)
+#error "FRAME_CRC must be 0, 16 or 32"
+#endif
+
+#if (UART_DMA_STAMP == 1) && (FRAME_CODEC != FRAME_NONE)
+#error "UART_DMA_STAMP requires raw forwarding (FRAME_CODEC = FRAME_NONE)"
+#endif
+
+#if (UART_DMA_STAMP == 1) && ((STAMP_RECORD_SIZE <= 6) || (STAMP_RECORD_SIZE > 0xFFFF))
+#error "STAMP_RECORD_SIZE must be between 7 and 65535"
+#endif
+
+#if (USB_CDC_PORTS != 1) && (USB_CDC_PORTS != 2)
+#error "USB_CDC_PORTS must be 1 or 2: the OTG FS has 6 endpoints, EP0 and 2 IN + 1 OUT endpoints per CDC function"
+#endif
+
+#if (USB_CDC_PORTS > 1) && ((FRAME_CODEC != FRAME_NONE) || (UART_DMA_STAMP == 1))
+#error "Several CDC functions require raw forwarding (FRAME_CODEC = FRAME_NONE, UART_DMA_STAMP = 0)"
+#endif
+
+#if (USB_BULK_ENABLE == 1) && ((FRAME_CODEC != FRAME_NONE) || (UART_DMA_STAMP == 1))
+#error "USB_BULK_ENABLE requires raw forwarding (FRAME_CODEC = FRAME_NONE, UART_DMA_STAMP = 0)"
+#endif
+
+#if (USB_BULK_ENABLE == 1) && (DMA_HT_ENABLE == 0)
+#error "USB_BULK_ENABLE requires DMA_HT_ENABLE: a continuous stream is sent while the other half of the buffer is filled"
+#endif
+
+#if (USB_BULK_ENABLE == 1) && ((USB_BULK_XFER_SIZE % 64) || (USB_BULK_XFER_SIZE == 0) || (USB_BULK_XFER_SIZE > 0xFFFF))
+#error "USB_BULK_XFER_SIZE must be a non-zero multiple of 64, below 64 KB"
+#endif
+
+#if (USB_BULK_ENABLE == 1) && (DMA_BUF_SIZE < 2 * USB_BULK_XFER_SIZE)
+#error "USB_BULK_ENABLE requires DMA_BUF_SIZE of at least 2 * USB_BULK_XFER_SIZE: a transfer is sent from one half of the buffer while the other half is filled"
+#endif
+
+#if (UART_TX_BUF_SIZE & (UART_TX_BUF_SIZE - 1))
+#error "UART_TX_BUF_SIZE must be a power of two"
+#endif
+
+#if (UART_TX_BUF_SIZE < 2 * 64)
+#error "UART_TX_BUF_SIZE must hold at least two USB packets (2 * CDC_DATA_FS_MAX_PACKET_SIZE = 128 bytes)"
+#endif
+
 #endif /* __MAIN_H */
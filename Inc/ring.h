@@ -0,0 +1,49 @@
+#ifndef __RING_H
+#define __RING_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define RING_IS_POW2(__N__)     (((__N__) != 0) && (((__N__) & ((__N__) - 1)) == 0))
+
+#define RING_SIZE(__RING__)     ((__RING__)->mask + 1)
+#define RING_COUNT(__RING__)    ((uint32_t)((__RING__)->wr - (__RING__)->rd))
+#define RING_FREE(__RING__)     (RING_SIZE(__RING__) - RING_COUNT(__RING__))
+
+/* Type definitions ----------------------------------------------------------*/
+/* Byte ring of power of two size
+ * Note: the read and write indices are free-running (never wrapped), the buffer position of an index
+ *       is (index & mask) and the number of bytes is (wr - rd), also across the 2^32 overflow.
+*/
+typedef struct
+{
+    uint8_t* buf;               /* Storage */
+    uint32_t mask;              /* Size - 1, size is a power of two */
+    volatile uint32_t wr;       /* Free-running write index */
+    volatile uint32_t rd;       /* Free-running read index */
+} Ring_t;
+
+typedef struct
+{
+    uint8_t* ptr;               /* Start of contiguous data in the ring */
+    uint32_t len;               /* Number of bytes */
+} RingSpan_t;
+
+/* Exported functions --------------------------------------------------------*/
+void Ring_Init(Ring_t* r, uint8_t* buf, uint32_t size);
+uint32_t Ring_Write(Ring_t* r, const uint8_t* data, uint32_t len);
+uint32_t Ring_Read(Ring_t* r, uint8_t* dst, uint32_t len);
+uint32_t Ring_Contiguous(const Ring_t* r);
+uint8_t Ring_GetSpans(const Ring_t* r, RingSpan_t* span);
+void Ring_Release(Ring_t* r, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RING_H */
@@ -0,0 +1,45 @@
+#ifndef __RX_QUEUE_H
+#define __RX_QUEUE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Configuration **************************************************************/
+#define RX_QUEUE_SIZE       8       /* Number of queue entries, must be a power of two */
+/******************************************************************************/
+
+/* Defines -------------------------------------------------------------------*/
+#define RX_CHUNK_FLUSH      0x01    /* Chunk was delivered by a timeout event: end of transmission */
+
+/* Type definitions ----------------------------------------------------------*/
+typedef struct
+{
+    uint32_t end;               /* Free-running DMA write index after the new data */
+    uint32_t stamp;             /* DWT timestamp of the end of the last character (UART_DMA_STAMP) */
+    uint8_t  flags;             /* RX_CHUNK_xxx flags */
+} RxChunk_t;
+
+/* Single-producer single-consumer queue
+ * Note: head is written by the producer only, tail is written by the consumer only.
+*/
+typedef struct
+{
+    volatile uint32_t head;     /* Free-running write index */
+    volatile uint32_t tail;     /* Free-running read index */
+    RxChunk_t item[RX_QUEUE_SIZE];
+} RxQueue_t;
+
+/* Exported functions --------------------------------------------------------*/
+uint8_t RxQueue_Push(RxQueue_t* q, const RxChunk_t* chunk);
+uint8_t RxQueue_Pop(RxQueue_t* q, RxChunk_t* chunk);
+uint8_t RxQueue_Merge(RxQueue_t* q, const RxChunk_t* chunk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RX_QUEUE_H */
@@ -0,0 +1,32 @@
+#ifndef __SCAN_H
+#define __SCAN_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "ring.h"
+
+/* Type definitions ----------------------------------------------------------*/
+/* Delimiter scanner of a ring
+ * Note: the indices are free-running ring indices, see Ring_t.
+*/
+typedef struct
+{
+    uint32_t start;             /* Start of the current record */
+    uint32_t pos;               /* Next byte to be scanned */
+    uint32_t pattern;           /* Delimiter repeated in every byte of a word */
+    uint8_t  delim;             /* Delimiter, e.g. '\n', 0x00 (COBS) or 0x7E (HDLC) */
+} Scan_t;
+
+/* Exported functions --------------------------------------------------------*/
+void Scan_Init(Scan_t* s, uint8_t delim);
+uint8_t Scan_Next(Scan_t* s, const Ring_t* r, RingSpan_t* span);
+uint8_t Scan_Flush(Scan_t* s, const Ring_t* r, RingSpan_t* span);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SCAN_H */
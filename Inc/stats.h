@@ -0,0 +1,85 @@
+#ifndef __STATS_H
+#define __STATS_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32l4xx.h"
+#include "main.h"
+
+/* Configuration **************************************************************/
+#define STATS_HIST_BINS     16      /* Latency histogram bins, bin n: [2^n, 2^(n+1)) usec */
+/******************************************************************************/
+
+/* Defines -------------------------------------------------------------------*/
+/* Vendor commands (CDC_SEND_ENCAPSULATED_COMMAND, first byte) */
+#define STATS_CMD_READ      0x01    /* Response: Stats_t snapshot */
+#define STATS_CMD_RESET     0x02    /* Response: none */
+
+/* Type definitions ----------------------------------------------------------*/
+/* RX path statistics, reported as little-endian 32-bit words in this order */
+typedef struct
+{
+    uint32_t rx_bytes;          /* Bytes received by the DMA */
+    uint32_t tc_events;         /* DMA Rx Complete events */
+    uint32_t ht_events;         /* DMA Rx Half Complete events */
+    uint32_t timeout_events;    /* DMA Timeout events */
+    uint32_t timeout_ignored;   /* Timeout events without new data */
+    uint32_t match_events;      /* Character match (terminator) flushes */
+    uint32_t frames;            /* Frames decoded by the framing stage */
+    uint32_t frame_errors;      /* Frames dropped by the framing stage */
+    uint32_t crc_errors;        /* Frames with invalid check sequence */
+    uint32_t usb_bytes;         /* Bytes queued for USB IN transfer */
+    uint32_t usb_busy;          /* USB IN transfers rejected with USBD_BUSY */
+    uint32_t parity_errors;     /* Characters received with parity error */
+    uint32_t framing_errors;    /* Characters received with framing error */
+    uint32_t noise_errors;      /* Characters received with noise error */
+    uint32_t overrun_errors;    /* Overruns: characters lost because the DMA did not read the receive data register in time */
+    uint32_t uart_errors;       /* DMA transfer errors of the receiver, reception restarted */
+    uint32_t isr_max_cycles;    /* Longest UART/DMA interrupt in CPU cycles */
+    uint32_t latency[STATS_HIST_BINS];  /* Idle event to USB submit latency histogram */
+} Stats_t;
+
+/* Latency measurement of a serial port: idle event waiting for USB submit */
+typedef struct
+{
+    uint32_t stamp;             /* DWT timestamp of the last idle event */
+    uint32_t epoch;             /* Statistics epoch of the idle event, 0: no idle event waiting */
+} Stats_Latency_t;
+
+/* Exported variables --------------------------------------------------------*/
+extern Stats_t stats;
+
+/* Instrumentation macros, compiled out if STATS_ENABLE is 0 */
+#if (STATS_ENABLE == 1)
+#define STATS_INC(__FIELD__)            (++stats.__FIELD__)
+#define STATS_ADD(__FIELD__, __N__)     (stats.__FIELD__ += (__N__))
+#define STATS_ISR_ENTER()               uint32_t stats_isr_start = DWT->CYCCNT
+#define STATS_ISR_EXIT()                Stats_IsrDuration(DWT->CYCCNT - stats_isr_start)
+#define STATS_IDLE_EVENT(__LAT__)       Stats_IdleEvent(__LAT__)
+#define STATS_USB_SUBMIT(__LAT__)       Stats_UsbSubmit(__LAT__)
+#else
+#define STATS_INC(__FIELD__)            ((void)0)
+#define STATS_ADD(__FIELD__, __N__)     ((void)0)
+#define STATS_ISR_ENTER()               ((void)0)
+#define STATS_ISR_EXIT()                ((void)0)
+#define STATS_IDLE_EVENT(__LAT__)       ((void)0)
+#define STATS_USB_SUBMIT(__LAT__)       ((void)0)
+#endif
+
+/* Exported functions --------------------------------------------------------*/
+void Stats_Init(void);
+void Stats_Reset(void);
+uint16_t Stats_Read(uint8_t* buf, uint16_t len);
+
+void Stats_IsrDuration(uint32_t cycles);
+void Stats_IdleEvent(Stats_Latency_t* lat);
+void Stats_UsbSubmit(Stats_Latency_t* lat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_H */
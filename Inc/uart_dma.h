@@ -0,0 +1,176 @@
+#ifndef __UART_DMA_H
+#define __UART_DMA_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include "stm32l4xx_hal.h"
+#include "main.h"
+#include "ring.h"
+#include "rx_queue.h"
+#include "stats.h"
+
+/* Defines -------------------------------------------------------------------*/
+/* Get the channel object from the HAL UART handle passed to the HAL callbacks */
+#define UART_DMA_FROM_HANDLE(__HANDLE__)    ((UART_DMA_t*)((uint8_t*)(__HANDLE__) - offsetof(UART_DMA_t, huart)))
+
+/* Gap histogram of the adaptive DMA Timeout: bin n counts the gaps of [2^n, 2^(n+1)) bit-times */
+#define DMA_ADAPT_BINS      24
+
+/* Holes left by DMA transfer errors, pending till the consumer has released the data before them */
+#define DMA_HOLE_MAX        2
+
+/* Type definitions ----------------------------------------------------------*/
+typedef enum
+{
+    UART_DMA_USART1 = 0,
+    UART_DMA_USART2,
+    UART_DMA_USART3,
+    UART_DMA_UART4,
+    UART_DMA_UART5,
+    UART_DMA_LPUART1,
+    UART_DMA_PORT_COUNT
+} UART_DMA_PortId_t;
+
+/* Hardware resources of a serial port */
+typedef struct
+{
+    USART_TypeDef*          instance;       /* UART peripheral */
+    IRQn_Type               irq;            /* UART interrupt */
+    DMA_Channel_TypeDef*    dma_rx;         /* DMA channel of the receiver */
+    uint32_t                dma_rx_request; /* DMA request mapping of the receiver */
+    IRQn_Type               dma_rx_irq;     /* DMA channel interrupt of the receiver */
+    DMA_Channel_TypeDef*    dma_tx;         /* DMA channel of the transmitter */
+    uint32_t                dma_tx_request; /* DMA request mapping of the transmitter */
+    IRQn_Type               dma_tx_irq;     /* DMA channel interrupt of the transmitter */
+} UART_DMA_Port_t;
+
+/* Rest of a DMA lap left by a DMA transfer error, never received */
+typedef struct
+{
+    uint32_t start;             /* Free-running index of the first character not received */
+    uint32_t end;               /* Free-running index of the next lap, where the reception continued */
+} DMA_Hole_t;
+
+typedef struct
+{
+    volatile uint8_t  flag;     /* Timeout event flag */
+    uint16_t timer;             /* Timeout duration in msec (SysTick engine only) */
+    uint32_t tcFlag;            /* Transfer Complete flag of the DMA channel */
+    uint32_t base;              /* Free-running write index at the start of the current DMA lap */
+    uint32_t wr;                /* Free-running write index of the last event */
+    uint32_t bitCycles;         /* CPU cycles per bit-time (DMA_ADAPT_ENABLE, UART_DMA_STAMP) */
+    uint8_t  charBits;          /* Bit-times per character: start, data, parity and stop bits */
+    uint32_t stamp;             /* DWT timestamp of the end of the last character received till stampWr (UART_DMA_STAMP) */
+    uint32_t stampWr;           /* Free-running write index when the stamp was latched */
+    uint32_t mark;              /* Free-running index of the character to be replaced by the error mark */
+    uint8_t  marked;            /* Error mark pending at mark (UART_ERROR_MARK) */
+    DMA_Hole_t hole[DMA_HOLE_MAX];  /* Holes not passed by the consumer yet, oldest first */
+    volatile uint8_t holes;     /* Number of pending holes */
+} DMA_Event_t;
+
+/* Adaptive DMA Timeout: line gaps measured at the idle events */
+typedef struct
+{
+    uint32_t stamp;             /* DWT timestamp of the last idle event */
+    uint32_t wr;                /* Free-running write index of the last idle event */
+    uint8_t  samples;           /* Gaps since the last aging of the histogram */
+    uint16_t hist[DMA_ADAPT_BINS];  /* Gap histogram, halved every DMA_ADAPT_AGING gaps */
+} DMA_Adapt_t;
+
+/* Contiguous data in DMA buffer */
+typedef RingSpan_t DMA_Span_t;
+
+typedef struct UART_DMA_s UART_DMA_t;
+
+/* Sink callback: called from the RX worker when new data is available */
+typedef void (*UART_DMA_Sink_t)(UART_DMA_t* ch);
+
+/* TX notify callback: called from the DMA interrupt when space is freed in the TX ring */
+typedef void (*UART_DMA_TxNotify_t)(UART_DMA_t* ch);
+
+/* Read completion callback: called from the RX worker when the data is copied and released */
+typedef void (*UART_DMA_ReadDone_t)(UART_DMA_t* ch, uint8_t* dst, uint32_t len);
+
+/* Asynchronous read states */
+#define UART_DMA_READ_IDLE      0   /* No read in progress */
+#define UART_DMA_READ_BUSY      1   /* Memory-to-memory DMA transfer in progress */
+#define UART_DMA_READ_DONE      2   /* Transfer complete, waiting for the RX worker */
+
+/* Asynchronous read of a serial port (memory-to-memory DMA) */
+typedef struct
+{
+    uint8_t*                dst;            /* Destination of the read in progress */
+    uint32_t                len;            /* Number of bytes of the read */
+    uint32_t                second;         /* Bytes of the second segment (from the buffer beginning) not started yet */
+    volatile uint8_t        state;          /* UART_DMA_READ_xxx */
+    UART_DMA_ReadDone_t     done;           /* Consumer to be notified */
+} UART_DMA_Read_t;
+
+/* TX ring of a serial port */
+typedef struct
+{
+    Ring_t                  ring;           /* TX ring: written by the producer, read by the DMA */
+    uint16_t                xfer;           /* Number of bytes of the DMA transfer in progress */
+    UART_DMA_TxNotify_t     notify;         /* Producer to be notified when space is freed */
+} UART_DMA_Tx_t;
+
+/* RX engine of a serial port */
+struct UART_DMA_s
+{
+    UART_HandleTypeDef      huart;          /* HAL UART handle */
+    DMA_HandleTypeDef       hdma_rx;        /* HAL DMA handle of the receiver */
+    DMA_HandleTypeDef       hdma_tx;        /* HAL DMA handle of the transmitter */
+    const UART_DMA_Port_t*  port;           /* Hardware resources */
+    uint8_t*                buf;            /* Circular buffer for DMA */
+    uint16_t                size;           /* Circular buffer size in bytes, power of two */
+    uint8_t                 engine;         /* DMA Timeout engine: DMA_TIMEOUT_SYSTICK or DMA_TIMEOUT_RTO */
+    uint32_t                timeout;        /* DMA Timeout duration: msec (SysTick engine) or bit-times (RTO engine), see UART_DMA_SetTimeout() */
+    DMA_Event_t             event;          /* DMA Timeout event and write index */
+    DMA_Adapt_t             adapt;          /* Adaptive DMA Timeout (DMA_ADAPT_ENABLE) */
+    Ring_t                  rx;             /* Consumer view of the DMA buffer: data committed by the worker, released by the consumer */
+    RxQueue_t               queue;          /* New data descriptors from ISR to worker */
+    RxChunk_t               carry;          /* Last published write index and flags not yet published because of full queue */
+    uint32_t                end;            /* Last write index taken from the queue by the worker, committed up to the oldest hole */
+    uint8_t                 flush;          /* End of transmission seen by the worker, cleared by the consumer */
+    RxQueue_t               stamps;         /* Committed chunks with arrival time, from worker to consumer (UART_DMA_STAMP) */
+    RxChunk_t               stamp;          /* Chunk of the oldest unreleased data (UART_DMA_STAMP) */
+    UART_DMA_Sink_t         sink;           /* Consumer of the received data */
+    void*                   context;        /* User context of the consumer */
+    UART_DMA_Tx_t           tx;             /* TX ring */
+    UART_DMA_Read_t         read;           /* Asynchronous read */
+    Stats_Latency_t         latency;        /* Idle event to USB submit latency measurement (STATS_ENABLE) */
+};
+
+/* Exported functions --------------------------------------------------------*/
+void UART_DMA_Init(UART_DMA_t* ch, UART_DMA_PortId_t id, uint32_t baudrate, uint8_t* buf, uint16_t size, UART_DMA_Sink_t sink);
+void UART_DMA_Start(UART_DMA_t* ch);
+void UART_DMA_InitTx(UART_DMA_t* ch, uint8_t* buf, uint16_t size, UART_DMA_TxNotify_t notify);
+
+uint16_t UART_DMA_Write(UART_DMA_t* ch, const uint8_t* data, uint16_t len);
+uint16_t UART_DMA_TxFree(UART_DMA_t* ch);
+
+HAL_StatusTypeDef UART_DMA_SetLineCoding(UART_DMA_t* ch, uint32_t baudrate, uint32_t wordlength, uint32_t stopbits, uint32_t parity);
+
+uint8_t UART_DMA_GetSpans(UART_DMA_t* ch, DMA_Span_t* span);
+void UART_DMA_Release(UART_DMA_t* ch, uint32_t len);
+uint8_t UART_DMA_GetStamped(UART_DMA_t* ch, DMA_Span_t* span, RxChunk_t* chunk);
+uint32_t UART_DMA_Read(UART_DMA_t* ch, uint8_t* dst, uint32_t len);
+HAL_StatusTypeDef UART_DMA_ReadAsync(UART_DMA_t* ch, uint8_t* dst, uint32_t len, UART_DMA_ReadDone_t done);
+
+void UART_DMA_Process(void);
+void UART_DMA_Schedule(void);
+void UART_DMA_TickHandler(void);
+void UART_DMA_IRQHandler(UART_DMA_PortId_t id);
+void UART_DMA_RxIRQHandler(UART_DMA_PortId_t id);
+void UART_DMA_TxIRQHandler(UART_DMA_PortId_t id);
+void UART_DMA_M2MIRQHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UART_DMA_H */
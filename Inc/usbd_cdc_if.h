@@ -8,11 +8,41 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_cdc.h"
 
+/* Defines -------------------------------------------------------------------*/
+#define CDC_TX_QUEUE_SIZE   4   /* Number of queued IN transfers, must be power of two */
+
+#if (CDC_TX_QUEUE_SIZE & (CDC_TX_QUEUE_SIZE - 1)) != 0
+#error "CDC_TX_QUEUE_SIZE must be a power of two"
+#endif
+
+/* Type definitions ----------------------------------------------------------*/
+typedef struct
+{
+    uint8_t* buf;               /* Data to be sent */
+    uint16_t len;               /* Number of bytes */
+    uint8_t zlp;                /* Terminate with a ZLP if packet size multiple */
+} CDC_TxItem_t;
+
+typedef struct
+{
+    volatile uint32_t head;     /* Transfer in progress, advanced by the USB interrupt */
+    volatile uint32_t tail;     /* Next free slot, advanced by CDC_Transmit_FS() */
+    CDC_TxItem_t item[CDC_TX_QUEUE_SIZE];
+} CDC_TxQueue_t;
+
 /* Exported variables --------------------------------------------------------*/
 extern USBD_CDC_ItfTypeDef  USBD_Interface_fops_FS;
 
 /* Exported functions --------------------------------------------------------*/
-uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
+uint8_t CDC_Transmit_FS(uint8_t port, uint8_t* Buf, uint16_t Len);
+void CDC_TxCpltCallback(uint8_t port, uint8_t* Buf, uint32_t Len);
+uint8_t CDC_TransmitBulk_FS(uint8_t* Buf, uint16_t Len, uint8_t zlp);
+void CDC_BulkTxCpltCallback(uint8_t* Buf, uint32_t Len);
+uint8_t CDC_ReceiveNext_FS(uint8_t port);
+uint8_t CDC_RxCallback(uint8_t port, uint8_t* Buf, uint32_t Len);
+uint8_t CDC_LineCodingCallback(uint8_t port, USBD_CDC_LineCodingTypeDef* coding);
+void CDC_CommandCallback(uint8_t* Buf, uint16_t Len);
+void CDC_ResponseCallback(uint8_t* Buf, uint16_t Len);
 
 
 #ifdef __cplusplus
@@ -53,6 +53,7 @@
 #include <string.h>
 #include "stm32l4xx.h"
 #include "stm32l4xx_hal.h"
+#include "main.h"
 
 /** @addtogroup USBD_OTG_DRIVER
   * @{
@@ -68,7 +69,10 @@
   */ 
 
 /*---------- -----------*/
-#define USBD_MAX_NUM_INTERFACES     1
+#define USBD_CDC_PORTS     USB_CDC_PORTS   /* CDC ACM functions, one per bridged serial port (see main.h) */
+#define USBD_CDC_BULK      USB_BULK_ENABLE /* Vendor-specific bulk IN interface (see main.h) */
+/*---------- -----------*/
+#define USBD_MAX_NUM_INTERFACES     (2 * USBD_CDC_PORTS + USBD_CDC_BULK)
 /*---------- -----------*/
 #define USBD_MAX_NUM_CONFIGURATION     1
 /*---------- -----------*/
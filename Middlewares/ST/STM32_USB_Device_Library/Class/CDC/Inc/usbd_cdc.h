@@ -53,12 +53,41 @@
 #define CDC_OUT_EP                                  0x01  /* EP1 for data OUT */
 #define CDC_CMD_EP                                  0x82  /* EP2 for CDC commands */
 
+/* Endpoints of the CDC function of port n (composite device): EP(2n+1) for data, EP(2n+2) for commands */
+#define CDC_IN_EP_PORT(n)                           (CDC_IN_EP + 2U * (n))
+#define CDC_OUT_EP_PORT(n)                          (CDC_OUT_EP + 2U * (n))
+#define CDC_CMD_EP_PORT(n)                          (CDC_CMD_EP + 2U * (n))
+#define CDC_EP_PORT(epnum)                          ((((epnum) & 0xFU) - 1U) / 2U)  /* Port of a data endpoint */
+#define CDC_ITF_PORT(itf)                           ((itf) / 2U)                    /* Port of an interface number */
+
+/* Vendor-specific bulk IN interface (USBD_CDC_BULK): interface and endpoint after the CDC functions,
+   its transfer state follows the ports */
+#define CDC_BULK_PORT                               USBD_CDC_PORTS
+#define CDC_BULK_ITF                                (2U * CDC_BULK_PORT)
+#define CDC_BULK_IN_EP                              CDC_IN_EP_PORT(CDC_BULK_PORT)
+
+/* Composite device: several CDC functions or the bulk interface next to the CDC function */
+#define USBD_CDC_COMPOSITE                          ((USBD_CDC_PORTS > 1) || (USBD_CDC_BULK == 1))
+
 /* CDC Endpoints parameters: you can fine tune these values depending on the needed baudrates and performance. */
 #define CDC_DATA_HS_MAX_PACKET_SIZE                 512  /* Endpoint IN & OUT Packet size */
 #define CDC_DATA_FS_MAX_PACKET_SIZE                 64  /* Endpoint IN & OUT Packet size */
 #define CDC_CMD_PACKET_SIZE                         8  /* Control Endpoint Packet size */ 
 
-#define USB_CDC_CONFIG_DESC_SIZ                     67
+/* Configuration descriptor: one CDC ACM function per port, each with an Interface Association Descriptor
+   in a composite device, and the bulk interface */
+#if USBD_CDC_COMPOSITE
+#define USB_CDC_IAD_DESC_SIZ                        8
+#else
+#define USB_CDC_IAD_DESC_SIZ                        0
+#endif
+#if (USBD_CDC_BULK == 1)
+#define USB_CDC_BULK_DESC_SIZ                       16
+#else
+#define USB_CDC_BULK_DESC_SIZ                       0
+#endif
+#define USB_CDC_FUNC_DESC_SIZ                       58
+#define USB_CDC_CONFIG_DESC_SIZ                     (9 + USBD_CDC_PORTS * (USB_CDC_IAD_DESC_SIZ + USB_CDC_FUNC_DESC_SIZ) + USB_CDC_BULK_DESC_SIZ)
 #define CDC_DATA_HS_IN_PACKET_SIZE                  CDC_DATA_HS_MAX_PACKET_SIZE
 #define CDC_DATA_HS_OUT_PACKET_SIZE                 CDC_DATA_HS_MAX_PACKET_SIZE
 
@@ -102,17 +131,16 @@ typedef struct _USBD_CDC_Itf
 {
   int8_t (* Init)          (void);
   int8_t (* DeInit)        (void);
-  int8_t (* Control)       (uint8_t, uint8_t * , uint16_t);   
-  int8_t (* Receive)       (uint8_t *, uint32_t *);  
+  int8_t (* Control)       (uint8_t, uint8_t, uint8_t * , uint16_t);   /* port, cmd, data, length */
+  int8_t (* Receive)       (uint8_t, uint8_t *, uint32_t *);             /* port, data, length */
+  int8_t (* TransmitCplt)  (uint8_t, uint8_t *, uint32_t *, uint8_t);    /* port, data, length, epnum */
 
 }USBD_CDC_ItfTypeDef;
 
 
+/* Data transfer state of a CDC function */
 typedef struct
 {
-  uint32_t data[CDC_DATA_HS_MAX_PACKET_SIZE/4];      /* Force 32bits alignment */
-  uint8_t  CmdOpCode;
-  uint8_t  CmdLength;    
   uint8_t  *RxBuffer;  
   uint8_t  *TxBuffer;   
   uint32_t RxLength;
@@ -120,6 +148,17 @@ typedef struct
   
   __IO uint32_t TxState;     
   __IO uint32_t RxState;    
+  uint8_t  TxZlp;                                    /* Terminate the transfer with a ZLP if MPS multiple */
+}
+USBD_CDC_PortTypeDef;
+
+typedef struct
+{
+  uint32_t data[CDC_DATA_HS_MAX_PACKET_SIZE/4];      /* Force 32bits alignment */
+  uint8_t  CmdOpCode;
+  uint16_t CmdLength;
+  uint8_t  CmdPort;                                  /* Port of the class request in the data stage */
+  USBD_CDC_PortTypeDef Port[USBD_CDC_PORTS + USBD_CDC_BULK];   /* Ports, then the bulk interface */
 }
 USBD_CDC_HandleTypeDef; 
 
@@ -150,15 +189,23 @@ uint8_t  USBD_CDC_RegisterInterface  (USBD_HandleTypeDef   *pdev,
                                       USBD_CDC_ItfTypeDef *fops);
 
 uint8_t  USBD_CDC_SetTxBuffer        (USBD_HandleTypeDef   *pdev,
+                                      uint8_t  port,
                                       uint8_t  *pbuff,
                                       uint16_t length);
 
+uint8_t  USBD_CDC_SetTxZlp           (USBD_HandleTypeDef   *pdev,
+                                      uint8_t  port,
+                                      uint8_t  zlp);
+
 uint8_t  USBD_CDC_SetRxBuffer        (USBD_HandleTypeDef   *pdev,
+                                      uint8_t  port,
                                       uint8_t  *pbuff);
   
-uint8_t  USBD_CDC_ReceivePacket      (USBD_HandleTypeDef *pdev);
+uint8_t  USBD_CDC_ReceivePacket      (USBD_HandleTypeDef *pdev,
+                                      uint8_t  port);
 
-uint8_t  USBD_CDC_TransmitPacket     (USBD_HandleTypeDef *pdev);
+uint8_t  USBD_CDC_TransmitPacket     (USBD_HandleTypeDef *pdev,
+                                      uint8_t  port);
 /**
   * @}
   */ 
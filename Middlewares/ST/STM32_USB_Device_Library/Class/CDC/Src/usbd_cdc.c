@@ -24,6 +24,9 @@
   *             - Device descriptor management
   *             - Configuration descriptor management
   *             - Enumeration as CDC device with 2 data endpoints (IN and OUT) and 1 command endpoint (IN)
+  *             - Composite device with USBD_CDC_PORTS CDC functions (Interface Association Descriptors),
+  *               endpoints and class requests are routed to the function by endpoint and interface number
+  *             - Optional vendor-specific interface with 1 bulk IN endpoint for raw streaming (USBD_CDC_BULK)
   *             - Requests management (as described in section 6.2 in specification)
   *             - Abstract Control Model compliant
   *             - Union Functional collection (using 1 IN endpoint for control)
@@ -174,99 +177,150 @@ USBD_ClassTypeDef  USBD_CDC =
   USBD_CDC_GetDeviceQualifierDescriptor,
 };
 
+/* Interface Association Descriptor of the CDC function of port n (composite device only) */
+#if USBD_CDC_COMPOSITE
+#define USBD_CDC_IAD_DESC(n)                                                    \
+  /*Interface Association Descriptor*/                                          \
+  0x08,   /* bLength: IAD size */                                               \
+  0x0B,   /* bDescriptorType: Interface Association */                          \
+  2 * (n),    /* bFirstInterface: Communication Interface */                    \
+  0x02,   /* bInterfaceCount: 2 interfaces */                                   \
+  0x02,   /* bFunctionClass: Communication Interface Class */                   \
+  0x02,   /* bFunctionSubClass: Abstract Control Model */                       \
+  0x01,   /* bFunctionProtocol: Common AT commands */                           \
+  0x00,   /* iFunction */
+#else
+#define USBD_CDC_IAD_DESC(n)
+#endif
+
+/* CDC function of port n: interfaces 2n (communication) and 2n+1 (data), endpoints of CDC_xxx_EP_PORT(n) */
+#define USBD_CDC_FUNC_DESC(n, mps, interval)                                    \
+  /*Interface Descriptor */                                                     \
+  0x09,   /* bLength: Interface Descriptor size */                              \
+  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */                    \
+  /* Interface descriptor type */                                               \
+  2 * (n),    /* bInterfaceNumber: Number of Interface */                       \
+  0x00,   /* bAlternateSetting: Alternate setting */                            \
+  0x01,   /* bNumEndpoints: One endpoints used */                               \
+  0x02,   /* bInterfaceClass: Communication Interface Class */                  \
+  0x02,   /* bInterfaceSubClass: Abstract Control Model */                      \
+  0x01,   /* bInterfaceProtocol: Common AT commands */                          \
+  0x00,   /* iInterface: */                                                     \
+                                                                                \
+  /*Header Functional Descriptor*/                                              \
+  0x05,   /* bLength: Endpoint Descriptor size */                               \
+  0x24,   /* bDescriptorType: CS_INTERFACE */                                   \
+  0x00,   /* bDescriptorSubtype: Header Func Desc */                            \
+  0x10,   /* bcdCDC: spec release number */                                     \
+  0x01,                                                                         \
+                                                                                \
+  /*Call Management Functional Descriptor*/                                     \
+  0x05,   /* bFunctionLength */                                                 \
+  0x24,   /* bDescriptorType: CS_INTERFACE */                                   \
+  0x01,   /* bDescriptorSubtype: Call Management Func Desc */                   \
+  0x00,   /* bmCapabilities: D0+D1 */                                           \
+  2 * (n) + 1,    /* bDataInterface */                                          \
+                                                                                \
+  /*ACM Functional Descriptor*/                                                 \
+  0x04,   /* bFunctionLength */                                                 \
+  0x24,   /* bDescriptorType: CS_INTERFACE */                                   \
+  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */            \
+  0x02,   /* bmCapabilities */                                                  \
+                                                                                \
+  /*Union Functional Descriptor*/                                               \
+  0x05,   /* bFunctionLength */                                                 \
+  0x24,   /* bDescriptorType: CS_INTERFACE */                                   \
+  0x06,   /* bDescriptorSubtype: Union func desc */                             \
+  2 * (n),    /* bMasterInterface: Communication class interface */             \
+  2 * (n) + 1,    /* bSlaveInterface0: Data Class Interface */                  \
+                                                                                \
+  /*Command Endpoint Descriptor*/                                               \
+  0x07,                           /* bLength: Endpoint Descriptor size */       \
+  USB_DESC_TYPE_ENDPOINT,   /* bDescriptorType: Endpoint */                     \
+  CDC_CMD_EP_PORT(n),             /* bEndpointAddress */                        \
+  0x03,                           /* bmAttributes: Interrupt */                 \
+  LOBYTE(CDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */                        \
+  HIBYTE(CDC_CMD_PACKET_SIZE),                                                  \
+  (interval),                     /* bInterval: */                              \
+  /*---------------------------------------------------------------------------*/ \
+                                                                                \
+  /*Data class interface descriptor*/                                           \
+  0x09,   /* bLength: Endpoint Descriptor size */                               \
+  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */                              \
+  2 * (n) + 1,    /* bInterfaceNumber: Number of Interface */                   \
+  0x00,   /* bAlternateSetting: Alternate setting */                            \
+  0x02,   /* bNumEndpoints: Two endpoints used */                               \
+  0x0A,   /* bInterfaceClass: CDC */                                            \
+  0x00,   /* bInterfaceSubClass: */                                             \
+  0x00,   /* bInterfaceProtocol: */                                             \
+  0x00,   /* iInterface: */                                                     \
+                                                                                \
+  /*Endpoint OUT Descriptor*/                                                   \
+  0x07,   /* bLength: Endpoint Descriptor size */                               \
+  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */                  \
+  CDC_OUT_EP_PORT(n),                /* bEndpointAddress */                     \
+  0x02,                              /* bmAttributes: Bulk */                   \
+  LOBYTE(mps),                       /* wMaxPacketSize: */                      \
+  HIBYTE(mps),                                                                  \
+  0x00,                              /* bInterval: ignore for Bulk transfer */  \
+                                                                                \
+  /*Endpoint IN Descriptor*/                                                    \
+  0x07,   /* bLength: Endpoint Descriptor size */                               \
+  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */                  \
+  CDC_IN_EP_PORT(n),                 /* bEndpointAddress */                     \
+  0x02,                              /* bmAttributes: Bulk */                   \
+  LOBYTE(mps),                       /* wMaxPacketSize: */                      \
+  HIBYTE(mps),                                                                  \
+  0x00,                              /* bInterval: ignore for Bulk transfer */
+
+/* Vendor-specific interface with one bulk IN endpoint (USBD_CDC_BULK only) */
+#if (USBD_CDC_BULK == 1)
+#define USBD_CDC_BULK_DESC(mps)                                                 \
+  /*Vendor interface descriptor*/                                               \
+  0x09,   /* bLength: Interface Descriptor size */                              \
+  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */                              \
+  CDC_BULK_ITF,   /* bInterfaceNumber: Number of Interface */                   \
+  0x00,   /* bAlternateSetting: Alternate setting */                            \
+  0x01,   /* bNumEndpoints: One endpoint used */                                \
+  0xFF,   /* bInterfaceClass: Vendor specific */                                \
+  0x00,   /* bInterfaceSubClass: */                                             \
+  0x00,   /* bInterfaceProtocol: */                                             \
+  0x00,   /* iInterface: */                                                     \
+                                                                                \
+  /*Endpoint IN Descriptor*/                                                    \
+  0x07,   /* bLength: Endpoint Descriptor size */                               \
+  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */                  \
+  CDC_BULK_IN_EP,                    /* bEndpointAddress */                     \
+  0x02,                              /* bmAttributes: Bulk */                   \
+  LOBYTE(mps),                       /* wMaxPacketSize: */                      \
+  HIBYTE(mps),                                                                  \
+  0x00,                              /* bInterval: ignore for Bulk transfer */
+#else
+#define USBD_CDC_BULK_DESC(mps)
+#endif
+
 /* USB CDC device Configuration Descriptor */
 __ALIGN_BEGIN uint8_t USBD_CDC_CfgHSDesc[USB_CDC_CONFIG_DESC_SIZ] __ALIGN_END =
 {
   /*Configuration Descriptor*/
   0x09,   /* bLength: Configuration Descriptor size */
   USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
-  USB_CDC_CONFIG_DESC_SIZ,                /* wTotalLength:no of returned bytes */
-  0x00,
-  0x02,   /* bNumInterfaces: 2 interface */
+  LOBYTE(USB_CDC_CONFIG_DESC_SIZ),  /* wTotalLength:no of returned bytes */
+  HIBYTE(USB_CDC_CONFIG_DESC_SIZ),
+  2 * USBD_CDC_PORTS + USBD_CDC_BULK,   /* bNumInterfaces: 2 interfaces per port and the bulk interface */
   0x01,   /* bConfigurationValue: Configuration value */
   0x00,   /* iConfiguration: Index of string descriptor describing the configuration */
   0xC0,   /* bmAttributes: self powered */
   0x32,   /* MaxPower 0 mA */
   
   /*---------------------------------------------------------------------------*/
-  
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x00,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-  
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bcdCDC: spec release number */
-  0x01,
-  
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-  
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-  
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x00,   /* bMasterInterface: Communication class interface */
-  0x01,   /* bSlaveInterface0: Data Class Interface */
-  
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,   /* bDescriptorType: Endpoint */
-  CDC_CMD_EP,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(CDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(CDC_CMD_PACKET_SIZE),
-  0x10,                           /* bInterval: */ 
-  /*---------------------------------------------------------------------------*/
-  
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x01,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: CDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-  
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  CDC_OUT_EP,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(CDC_DATA_HS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(CDC_DATA_HS_MAX_PACKET_SIZE),
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-  
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  CDC_IN_EP,                         /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(CDC_DATA_HS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(CDC_DATA_HS_MAX_PACKET_SIZE),
-  0x00                               /* bInterval: ignore for Bulk transfer */
+  USBD_CDC_IAD_DESC(0)
+  USBD_CDC_FUNC_DESC(0, CDC_DATA_HS_MAX_PACKET_SIZE, 0x10)
+#if (USBD_CDC_PORTS > 1)
+  USBD_CDC_IAD_DESC(1)
+  USBD_CDC_FUNC_DESC(1, CDC_DATA_HS_MAX_PACKET_SIZE, 0x10)
+#endif
+  USBD_CDC_BULK_DESC(CDC_DATA_HS_MAX_PACKET_SIZE)
 } ;
 
 
@@ -276,185 +330,43 @@ __ALIGN_BEGIN uint8_t USBD_CDC_CfgFSDesc[USB_CDC_CONFIG_DESC_SIZ] __ALIGN_END =
   /*Configuration Descriptor*/
   0x09,   /* bLength: Configuration Descriptor size */
   USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
-  USB_CDC_CONFIG_DESC_SIZ,                /* wTotalLength:no of returned bytes */
-  0x00,
-  0x02,   /* bNumInterfaces: 2 interface */
+  LOBYTE(USB_CDC_CONFIG_DESC_SIZ),  /* wTotalLength:no of returned bytes */
+  HIBYTE(USB_CDC_CONFIG_DESC_SIZ),
+  2 * USBD_CDC_PORTS + USBD_CDC_BULK,   /* bNumInterfaces: 2 interfaces per port and the bulk interface */
   0x01,   /* bConfigurationValue: Configuration value */
   0x00,   /* iConfiguration: Index of string descriptor describing the configuration */
   0xC0,   /* bmAttributes: self powered */
   0x32,   /* MaxPower 0 mA */
   
   /*---------------------------------------------------------------------------*/
-  
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x00,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-  
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bcdCDC: spec release number */
-  0x01,
-  
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-  
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-  
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x00,   /* bMasterInterface: Communication class interface */
-  0x01,   /* bSlaveInterface0: Data Class Interface */
-  
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,   /* bDescriptorType: Endpoint */
-  CDC_CMD_EP,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(CDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(CDC_CMD_PACKET_SIZE),
-  0x10,                           /* bInterval: */ 
-  /*---------------------------------------------------------------------------*/
-  
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x01,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: CDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-  
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  CDC_OUT_EP,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-  
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  CDC_IN_EP,                         /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00                               /* bInterval: ignore for Bulk transfer */
+  USBD_CDC_IAD_DESC(0)
+  USBD_CDC_FUNC_DESC(0, CDC_DATA_FS_MAX_PACKET_SIZE, 0x10)
+#if (USBD_CDC_PORTS > 1)
+  USBD_CDC_IAD_DESC(1)
+  USBD_CDC_FUNC_DESC(1, CDC_DATA_FS_MAX_PACKET_SIZE, 0x10)
+#endif
+  USBD_CDC_BULK_DESC(CDC_DATA_FS_MAX_PACKET_SIZE)
 } ;
 
 __ALIGN_BEGIN uint8_t USBD_CDC_OtherSpeedCfgDesc[USB_CDC_CONFIG_DESC_SIZ] __ALIGN_END =
 { 
   0x09,   /* bLength: Configuation Descriptor size */
   USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION,   
-  USB_CDC_CONFIG_DESC_SIZ,
-  0x00,
-  0x02,   /* bNumInterfaces: 2 interfaces */
+  LOBYTE(USB_CDC_CONFIG_DESC_SIZ),
+  HIBYTE(USB_CDC_CONFIG_DESC_SIZ),
+  2 * USBD_CDC_PORTS + USBD_CDC_BULK,   /* bNumInterfaces: 2 interfaces per port and the bulk interface */
   0x01,   /* bConfigurationValue: */
   0x04,   /* iConfiguration: */
   0xC0,   /* bmAttributes: */
   0x32,   /* MaxPower 100 mA */  
   
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x00,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-  
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bcdCDC: spec release number */
-  0x01,
-  
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-  
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-  
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x00,   /* bMasterInterface: Communication class interface */
-  0x01,   /* bSlaveInterface0: Data Class Interface */
-  
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT      ,   /* bDescriptorType: Endpoint */
-  CDC_CMD_EP,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(CDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(CDC_CMD_PACKET_SIZE),
-  0xFF,                           /* bInterval: */
-  
-  /*---------------------------------------------------------------------------*/
-  
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x01,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: CDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-  
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  CDC_OUT_EP,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  0x40,                              /* wMaxPacketSize: */
-  0x00,
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-  
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,     /* bDescriptorType: Endpoint */
-  CDC_IN_EP,                        /* bEndpointAddress */
-  0x02,                             /* bmAttributes: Bulk */
-  0x40,                             /* wMaxPacketSize: */
-  0x00,
-  0x00                              /* bInterval */
+  USBD_CDC_IAD_DESC(0)
+  USBD_CDC_FUNC_DESC(0, 0x40, 0xFF)
+#if (USBD_CDC_PORTS > 1)
+  USBD_CDC_IAD_DESC(1)
+  USBD_CDC_FUNC_DESC(1, 0x40, 0xFF)
+#endif
+  USBD_CDC_BULK_DESC(0x40)
 };
 
 /**
@@ -476,43 +388,38 @@ static uint8_t  USBD_CDC_Init (USBD_HandleTypeDef *pdev,
                                uint8_t cfgidx)
 {
   uint8_t ret = 0;
+  uint8_t port;
   USBD_CDC_HandleTypeDef   *hcdc;
+  uint16_t mps = (pdev->dev_speed == USBD_SPEED_HIGH) ? CDC_DATA_HS_MAX_PACKET_SIZE : CDC_DATA_FS_MAX_PACKET_SIZE;
   
-  if(pdev->dev_speed == USBD_SPEED_HIGH  ) 
-  {  
+  for(port = 0; port < USBD_CDC_PORTS; port++)
+  {
     /* Open EP IN */
     USBD_LL_OpenEP(pdev,
-                   CDC_IN_EP,
+                   CDC_IN_EP_PORT(port),
                    USBD_EP_TYPE_BULK,
-                   CDC_DATA_HS_IN_PACKET_SIZE);
+                   mps);
     
     /* Open EP OUT */
     USBD_LL_OpenEP(pdev,
-                   CDC_OUT_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_HS_OUT_PACKET_SIZE);
-    
-  }
-  else
-  {
-    /* Open EP IN */
-    USBD_LL_OpenEP(pdev,
-                   CDC_IN_EP,
+                   CDC_OUT_EP_PORT(port),
                    USBD_EP_TYPE_BULK,
-                   CDC_DATA_FS_IN_PACKET_SIZE);
+                   mps);
     
-    /* Open EP OUT */
+    /* Open Command IN EP */
     USBD_LL_OpenEP(pdev,
-                   CDC_OUT_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_FS_OUT_PACKET_SIZE);
+                   CDC_CMD_EP_PORT(port),
+                   USBD_EP_TYPE_INTR,
+                   CDC_CMD_PACKET_SIZE);
   }
-  /* Open Command IN EP */
-  USBD_LL_OpenEP(pdev,
-                 CDC_CMD_EP,
-                 USBD_EP_TYPE_INTR,
-                 CDC_CMD_PACKET_SIZE);
   
+#if (USBD_CDC_BULK == 1)
+  /* Open bulk IN EP */
+  USBD_LL_OpenEP(pdev,
+                 CDC_BULK_IN_EP,
+                 USBD_EP_TYPE_BULK,
+                 mps);
+#endif
     
   pdev->pClassData = USBD_malloc(sizeof (USBD_CDC_HandleTypeDef));
   
@@ -527,28 +434,22 @@ static uint8_t  USBD_CDC_Init (USBD_HandleTypeDef *pdev,
     /* Init  physical Interface components */
     ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Init();
     
-    /* Init Xfer states */
-    hcdc->TxState =0;
-    hcdc->RxState =0;
-       
-    if(pdev->dev_speed == USBD_SPEED_HIGH  ) 
-    {      
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev,
-                             CDC_OUT_EP,
-                             hcdc->RxBuffer,
-                             CDC_DATA_HS_OUT_PACKET_SIZE);
-    }
-    else
+#if (USBD_CDC_BULK == 1)
+    hcdc->Port[CDC_BULK_PORT].TxState =0;
+#endif
+    
+    for(port = 0; port < USBD_CDC_PORTS; port++)
     {
+      /* Init Xfer states */
+      hcdc->Port[port].TxState =0;
+      hcdc->Port[port].RxState =0;
+      
       /* Prepare Out endpoint to receive next packet */
       USBD_LL_PrepareReceive(pdev,
-                             CDC_OUT_EP,
-                             hcdc->RxBuffer,
-                             CDC_DATA_FS_OUT_PACKET_SIZE);
+                             CDC_OUT_EP_PORT(port),
+                             hcdc->Port[port].RxBuffer,
+                             mps);
     }
-    
-    
   }
   return ret;
 }
@@ -564,18 +465,28 @@ static uint8_t  USBD_CDC_DeInit (USBD_HandleTypeDef *pdev,
                                  uint8_t cfgidx)
 {
   uint8_t ret = 0;
+  uint8_t port;
   
-  /* Open EP IN */
-  USBD_LL_CloseEP(pdev,
-              CDC_IN_EP);
-  
-  /* Open EP OUT */
-  USBD_LL_CloseEP(pdev,
-              CDC_OUT_EP);
+  for(port = 0; port < USBD_CDC_PORTS; port++)
+  {
+    /* Close EP IN */
+    USBD_LL_CloseEP(pdev,
+                CDC_IN_EP_PORT(port));
+    
+    /* Close EP OUT */
+    USBD_LL_CloseEP(pdev,
+                CDC_OUT_EP_PORT(port));
+    
+    /* Close Command IN EP */
+    USBD_LL_CloseEP(pdev,
+                CDC_CMD_EP_PORT(port));
+  }
   
-  /* Open Command IN EP */
+#if (USBD_CDC_BULK == 1)
+  /* Close bulk IN EP */
   USBD_LL_CloseEP(pdev,
-              CDC_CMD_EP);
+              CDC_BULK_IN_EP);
+#endif
   
   
   /* DeInit  physical Interface components */
@@ -601,35 +512,48 @@ static uint8_t  USBD_CDC_Setup (USBD_HandleTypeDef *pdev,
 {
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   static uint8_t ifalt = 0;
+  uint8_t port = CDC_ITF_PORT(LOBYTE(req->wIndex));
+  uint16_t len;
     
   switch (req->bmRequest & USB_REQ_TYPE_MASK)
   {
   case USB_REQ_TYPE_CLASS :
+    /* Class requests are addressed to the communication interface of the port */
+    if (port >= USBD_CDC_PORTS)
+    {
+      USBD_CtlError (pdev, req);
+      return USBD_FAIL;
+    }
     if (req->wLength)
     {
+      /* The data stage is limited to the class data buffer */
+      len = MIN(req->wLength, sizeof(hcdc->data));
       if (req->bmRequest & 0x80)
       {
-        ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(req->bRequest,
+        ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(port,
+                                                          req->bRequest,
                                                           (uint8_t *)hcdc->data,
-                                                          req->wLength);
+                                                          len);
           USBD_CtlSendData (pdev, 
                             (uint8_t *)hcdc->data,
-                            req->wLength);
+                            len);
       }
       else
       {
         hcdc->CmdOpCode = req->bRequest;
-        hcdc->CmdLength = req->wLength;
+        hcdc->CmdLength = len;
+        hcdc->CmdPort = port;
         
         USBD_CtlPrepareRx (pdev, 
                            (uint8_t *)hcdc->data,
-                           req->wLength);
+                           len);
       }
       
     }
     else
     {
-      ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(req->bRequest,
+      ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(port,
+                                                        req->bRequest,
                                                         (uint8_t*)req,
                                                         0);
     }
@@ -664,11 +588,28 @@ static uint8_t  USBD_CDC_Setup (USBD_HandleTypeDef *pdev,
 static uint8_t  USBD_CDC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t maxpacket = (pdev->dev_speed == USBD_SPEED_HIGH) ? CDC_DATA_HS_IN_PACKET_SIZE : CDC_DATA_FS_IN_PACKET_SIZE;
+  uint8_t port = CDC_EP_PORT(epnum);
   
-  if(pdev->pClassData != NULL)
+  if((pdev->pClassData != NULL) && (port < USBD_CDC_PORTS + USBD_CDC_BULK))
   {
-    
-    hcdc->TxState = 0;
+    if((pdev->ep_in[epnum & 0xFU].total_length > 0U) &&
+       ((pdev->ep_in[epnum & 0xFU].total_length % maxpacket) == 0U))
+    {
+      /* Last packet is MPS multiple, terminate the transfer with a ZLP, the buffer is the one of the transfer */
+      pdev->ep_in[epnum & 0xFU].total_length = 0U;
+      USBD_LL_Transmit(pdev, epnum, hcdc->Port[port].TxBuffer, 0U);
+    }
+    else
+    {
+      hcdc->Port[port].TxState = 0;
+      
+      /* Notify the interface that the transfer is complete */
+      if(((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt != NULL)
+      {
+        ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt(port, hcdc->Port[port].TxBuffer, &hcdc->Port[port].TxLength, epnum);
+      }
+    }
 
     return USBD_OK;
   }
@@ -688,15 +629,16 @@ static uint8_t  USBD_CDC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t  USBD_CDC_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {      
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
-  
-  /* Get the received data length */
-  hcdc->RxLength = USBD_LL_GetRxDataSize (pdev, epnum);
+  uint8_t port = CDC_EP_PORT(epnum);
   
   /* USB data will be immediately processed, this allow next USB traffic being 
   NAKed till the end of the application Xfer */
-  if(pdev->pClassData != NULL)
+  if((pdev->pClassData != NULL) && (port < USBD_CDC_PORTS))
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Receive(hcdc->RxBuffer, &hcdc->RxLength);
+    /* Get the received data length */
+    hcdc->Port[port].RxLength = USBD_LL_GetRxDataSize (pdev, epnum);
+    
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Receive(port, hcdc->Port[port].RxBuffer, &hcdc->Port[port].RxLength);
 
     return USBD_OK;
   }
@@ -721,7 +663,8 @@ static uint8_t  USBD_CDC_EP0_RxReady (USBD_HandleTypeDef *pdev)
   
   if((pdev->pUserData != NULL) && (hcdc->CmdOpCode != 0xFF))
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(hcdc->CmdOpCode,
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(hcdc->CmdPort,
+                                                      hcdc->CmdOpCode,
                                                       (uint8_t *)hcdc->data,
                                                       hcdc->CmdLength);
       hcdc->CmdOpCode = 0xFF; 
@@ -804,17 +747,41 @@ uint8_t  USBD_CDC_RegisterInterface  (USBD_HandleTypeDef   *pdev,
 /**
   * @brief  USBD_CDC_SetTxBuffer
   * @param  pdev: device instance
+  * @param  port: CDC function or CDC_BULK_PORT
   * @param  pbuff: Tx Buffer
   * @retval status
   */
 uint8_t  USBD_CDC_SetTxBuffer  (USBD_HandleTypeDef   *pdev,
+                                uint8_t  port,
                                 uint8_t  *pbuff,
                                 uint16_t length)
 {
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   
-  hcdc->TxBuffer = pbuff;
-  hcdc->TxLength = length;  
+  hcdc->Port[port].TxBuffer = pbuff;
+  hcdc->Port[port].TxLength = length;  
+  hcdc->Port[port].TxZlp = 1;
+  
+  return USBD_OK;  
+}
+
+/**
+  * @brief  USBD_CDC_SetTxZlp
+  *         Select the termination of the next transfer, after USBD_CDC_SetTxBuffer.
+  *         Without ZLP, a transfer of MPS multiple length does not end the host
+  *         read, the stream continues in the next transfer.
+  * @param  pdev: device instance
+  * @param  port: CDC function or CDC_BULK_PORT
+  * @param  zlp: 1 to terminate with a ZLP (default), 0 to continue the stream
+  * @retval status
+  */
+uint8_t  USBD_CDC_SetTxZlp  (USBD_HandleTypeDef   *pdev,
+                             uint8_t  port,
+                             uint8_t  zlp)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  
+  hcdc->Port[port].TxZlp = zlp;
   
   return USBD_OK;  
 }
@@ -823,42 +790,47 @@ uint8_t  USBD_CDC_SetTxBuffer  (USBD_HandleTypeDef   *pdev,
 /**
   * @brief  USBD_CDC_SetRxBuffer
   * @param  pdev: device instance
+  * @param  port: CDC function
   * @param  pbuff: Rx Buffer
   * @retval status
   */
 uint8_t  USBD_CDC_SetRxBuffer  (USBD_HandleTypeDef   *pdev,
+                                   uint8_t  port,
                                    uint8_t  *pbuff)
 {
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   
-  hcdc->RxBuffer = pbuff;
+  hcdc->Port[port].RxBuffer = pbuff;
   
   return USBD_OK;
 }
 
 /**
-  * @brief  USBD_CDC_DataOut
-  *         Data received on non-control Out endpoint
+  * @brief  USBD_CDC_TransmitPacket
+  *         Start the IN transfer of the Tx buffer
   * @param  pdev: device instance
-  * @param  epnum: endpoint number
+  * @param  port: CDC function or CDC_BULK_PORT
   * @retval status
   */
-uint8_t  USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
+uint8_t  USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, uint8_t port)
 {      
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   
   if(pdev->pClassData != NULL)
   {
-    if(hcdc->TxState == 0)
+    if(hcdc->Port[port].TxState == 0)
     {
       /* Tx Transfer in progress */
-      hcdc->TxState = 1;
+      hcdc->Port[port].TxState = 1;
+      
+      /* Update the packet total length, used for ZLP handling on completion (0: no ZLP) */
+      pdev->ep_in[CDC_IN_EP_PORT(port) & 0xFU].total_length = hcdc->Port[port].TxZlp ? hcdc->Port[port].TxLength : 0U;
       
       /* Transmit next packet */
       USBD_LL_Transmit(pdev,
-                       CDC_IN_EP,
-                       hcdc->TxBuffer,
-                       hcdc->TxLength);
+                       CDC_IN_EP_PORT(port),
+                       hcdc->Port[port].TxBuffer,
+                       hcdc->Port[port].TxLength);
       
       return USBD_OK;
     }
@@ -878,9 +850,10 @@ uint8_t  USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev)
   * @brief  USBD_CDC_ReceivePacket
   *         prepare OUT Endpoint for reception
   * @param  pdev: device instance
+  * @param  port: CDC function
   * @retval status
   */
-uint8_t  USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
+uint8_t  USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, uint8_t port)
 {      
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   
@@ -891,16 +864,16 @@ uint8_t  USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev)
     {      
       /* Prepare Out endpoint to receive next packet */
       USBD_LL_PrepareReceive(pdev,
-                             CDC_OUT_EP,
-                             hcdc->RxBuffer,
+                             CDC_OUT_EP_PORT(port),
+                             hcdc->Port[port].RxBuffer,
                              CDC_DATA_HS_OUT_PACKET_SIZE);
     }
     else
     {
       /* Prepare Out endpoint to receive next packet */
       USBD_LL_PrepareReceive(pdev,
-                             CDC_OUT_EP,
-                             hcdc->RxBuffer,
+                             CDC_OUT_EP_PORT(port),
+                             hcdc->Port[port].RxBuffer,
                              CDC_DATA_FS_OUT_PACKET_SIZE);
     }
     return USBD_OK;
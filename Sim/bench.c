@@ -0,0 +1,245 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   bench.c
+  * @brief  RX engine benchmark on the host
+  *         This file replays a bursty byte stream at a given baud rate into
+  *         the simulated UART, and reports throughput, dropped bytes and
+  *         flush latency for each DMA buffer size and timeout combination.
+  *
+  *         Build (from the repository root):
+  *           gcc -O2 -no-pie -Wno-pointer-to-int-cast -ISim -IInc -o bench
+  *               Sim/bench.c Sim/sim.c Sim/sim_hal.c
+  *               Src/uart_dma.c Src/ring.c Src/rx_queue.c Src/stats.c
+  *
+  *         Usage:
+  *           ./bench [baud] [burst] [gap] [total] [drain]
+  *             baud:  baud rate in bits/sec (115200)
+  *             burst: characters per burst (256)
+  *             gap:   idle line between bursts in bit-times (2000)
+  *             total: characters to send (200000)
+  *             drain: consumer speed in bytes/msec, 0: unlimited (0)
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define PS_PER_SEC          1000000000000ULL
+#define PS_PER_MS           1000000000ULL
+#define NEVER               UINT64_MAX
+#define BURST_QUEUE         64      /* Bursts waiting for latency measurement */
+#define DRAIN_TIME_MS       10000   /* Simulated time limit after the last character */
+
+/* Type definitions ----------------------------------------------------------*/
+typedef struct
+{
+    uint32_t baud;
+    uint16_t size;
+    uint32_t timeout;
+    uint32_t burst;
+    uint32_t gap;
+    uint32_t total;
+    uint32_t drain;
+} Bench_Config_t;
+
+typedef struct
+{
+    uint64_t endIndex;              /* Stream index after the last character of the burst */
+    uint64_t endTime;               /* End of the stop bit of the last character */
+} Bench_Burst_t;
+
+typedef struct
+{
+    uint64_t time;                  /* Time of the last delivery */
+    uint64_t latencySum;
+    uint64_t latencyMax;
+    uint32_t latencyCount;
+} Bench_Result_t;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Bench_Run(const Bench_Config_t* cfg, Bench_Result_t* res);
+
+/** Main function *************************************************************/
+int main(int argc, char* argv[])
+{
+    static const uint16_t sizes[] = { 16, 32, 64, 128, 256, 512, 1024, 4096, 16384 };
+    static const uint32_t timeoutsMs[] = { 1, 2, 5, 10, 20 };
+    static const uint32_t timeoutsBits[] = { 10, 20, 50, 100, 1000 };
+    const uint32_t* timeouts;
+    const Sim_Counters_t* cnt;
+    Bench_Config_t cfg;
+    Bench_Result_t res;
+    uint32_t s, t;
+
+    cfg.baud  = (argc > 1) ? strtoul(argv[1], NULL, 0) : 115200;
+    cfg.burst = (argc > 2) ? strtoul(argv[2], NULL, 0) : 256;
+    cfg.gap   = (argc > 3) ? strtoul(argv[3], NULL, 0) : 2000;
+    cfg.total = (argc > 4) ? strtoul(argv[4], NULL, 0) : 200000;
+    cfg.drain = (argc > 5) ? strtoul(argv[5], NULL, 0) : 0;
+    if(cfg.baud == 0 || cfg.burst == 0 || cfg.total == 0)
+    {
+        fprintf(stderr, "usage: %s [baud] [burst] [gap] [total] [drain]\n", argv[0]);
+        return 1;
+    }
+
+    timeouts = (DMA_TIMEOUT_ENGINE == DMA_TIMEOUT_RTO) ? timeoutsBits : timeoutsMs;
+
+    printf("engine=%s ht=%d adapt=%d baud=%u burst=%u gap=%u bits total=%u drain=%u B/ms\n",
+           (DMA_TIMEOUT_ENGINE == DMA_TIMEOUT_RTO) ? "RTO" : "SysTick", DMA_HT_ENABLE, DMA_ADAPT_ENABLE,
+           cfg.baud, cfg.burst, cfg.gap, cfg.total, cfg.drain);
+    printf("%6s %8s %12s %10s %10s %12s %12s\n",
+           "size", (DMA_TIMEOUT_ENGINE == DMA_TIMEOUT_RTO) ? "tmo[bit]" : "tmo[ms]",
+           "bytes/s", "dropped", "corrupted", "lat.avg[us]", "lat.max[us]");
+
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        for(t = 0; t < 5; ++t)
+        {
+            cfg.size = sizes[s];
+            cfg.timeout = timeouts[t];
+            Bench_Run(&cfg, &res);
+
+            cnt = Sim_GetCounters();
+            printf("%6u %8u %12.0f %10llu %10llu %12.1f %12.1f\n",
+                   cfg.size, cfg.timeout,
+                   res.time ? (double)cnt->delivered * PS_PER_SEC / res.time : 0.0,
+                   (unsigned long long)(cnt->sent - (cnt->delivered - cnt->corrupted)),
+                   (unsigned long long)cnt->corrupted,
+                   res.latencyCount ? (double)res.latencySum / res.latencyCount / 1e6 : 0.0,
+                   (double)res.latencyMax / 1e6);
+        }
+    }
+
+    return 0;
+}
+
+/** Event driven simulation
+ * Simulated time is in picoseconds. The events are the end of a received character (8N1: 10 bit-times),
+ * the idle line detection one character time after the last character, the receiver timeout after
+ * RTOR bit-times, and the SysTick every msec. Each interrupt is serviced immediately and PendSV runs
+ * after it. The DWT cycle counter follows the simulated time (adaptive DMA Timeout). The flush latency of a burst is measured from the end of its last character until the
+ * consumer has seen it.
+*/
+static void Bench_Run(const Bench_Config_t* cfg, Bench_Result_t* res)
+{
+    const Sim_Counters_t* cnt = Sim_GetCounters();
+    UART_DMA_t* ch;
+    Bench_Burst_t burst[BURST_QUEUE];
+    uint32_t bHead = 0, bTail = 0;
+    uint64_t bitPs = PS_PER_SEC / cfg->baud;
+    uint64_t charPs = 10 * bitPs;
+    uint64_t now = 0, end = NEVER;
+    uint64_t nextChar = charPs, nextTick = PS_PER_MS, idleAt = NEVER, rtoAt = NEVER;
+    uint32_t inBurst = 0;
+    uint64_t latency;
+
+    DWT->CYCCNT = 0;
+    Sim_Reset(cfg->size, 12345);
+    Sim_SetTimeout(cfg->timeout);
+    Sim_SetDrain(cfg->drain);
+    ch = Sim_Channel();
+
+    res->time = 0;
+    res->latencySum = 0;
+    res->latencyMax = 0;
+    res->latencyCount = 0;
+
+    while(now < end)
+    {
+        /* Next event */
+        now = nextTick;
+        if(cnt->sent < cfg->total && nextChar < now)
+        {
+            now = nextChar;
+        }
+        if(idleAt < now)
+        {
+            now = idleAt;
+        }
+        if(rtoAt < now)
+        {
+            now = rtoAt;
+        }
+        DWT->CYCCNT = (uint32_t)(now * (SystemCoreClock / 1000000) / 1000000);
+
+        if(cnt->sent < cfg->total && now == nextChar)
+        {
+            Sim_LineRx();
+            Sim_DmaIrq();
+            idleAt = now + charPs;
+            rtoAt = now + (uint64_t)(ch->huart.Instance->RTOR & USART_RTOR_RTO) * bitPs;
+
+            if(++inBurst == cfg->burst || cnt->sent == cfg->total)
+            {
+                if(bHead - bTail < BURST_QUEUE)
+                {
+                    burst[bHead % BURST_QUEUE].endIndex = cnt->sent;
+                    burst[bHead % BURST_QUEUE].endTime = now;
+                    ++bHead;
+                }
+                inBurst = 0;
+                nextChar = now + (uint64_t)cfg->gap * bitPs + charPs;
+            }
+            else
+            {
+                nextChar = now + charPs;
+            }
+
+            if(cnt->sent == cfg->total)
+            {
+                end = now + DRAIN_TIME_MS * PS_PER_MS;
+            }
+        }
+        else if(now == idleAt)
+        {
+            idleAt = NEVER;
+            Sim_UartIdle();
+            /* RTOR may be changed by the adaptive timeout, the counter runs from the last character */
+            if(rtoAt != NEVER)
+            {
+                rtoAt = now - charPs + (uint64_t)(ch->huart.Instance->RTOR & USART_RTOR_RTO) * bitPs;
+                rtoAt = (rtoAt < now) ? now : rtoAt;
+            }
+        }
+        else if(now == rtoAt)
+        {
+            rtoAt = NEVER;
+            Sim_UartRto();
+        }
+        else
+        {
+            nextTick += PS_PER_MS;
+            Sim_Tick();
+        }
+
+        Sim_PendSV();
+
+        /* Flush latency */
+        while(bTail != bHead && cnt->delivered + cnt->dropped >= burst[bTail % BURST_QUEUE].endIndex)
+        {
+            latency = now - burst[bTail % BURST_QUEUE].endTime;
+            res->latencySum += latency;
+            res->latencyCount++;
+            if(latency > res->latencyMax)
+            {
+                res->latencyMax = latency;
+            }
+            ++bTail;
+        }
+
+        if(cnt->sent == cfg->total && cnt->delivered + cnt->dropped + cnt->lost >= cnt->sent)
+        {
+            res->time = now;
+            break;
+        }
+        res->time = now;
+    }
+}
@@ -0,0 +1,460 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   bulkhost.c
+  * @brief  Bulk streaming test on the host
+  *         This file stands in for the bulk IN endpoint of the vendor-specific
+  *         interface and for the host reading it, without a USB stack. The
+  *         received byte stream is replayed into the simulated UART, streamed
+  *         by bulk.c, and the host verifies the data, the termination of its
+  *         read requests and the bus usage.
+  *
+  *         Build (from the repository root), with USB_BULK_ENABLE and
+  *         DMA_HT_ENABLE set and DMA_BUF_SIZE of at least 2 * USB_BULK_XFER_SIZE
+  *         in main.h like the firmware requires:
+  *           gcc -O2 -no-pie -Wno-pointer-to-int-cast -ISim -IInc -o bulkhost
+  *               Sim/bulkhost.c Sim/sim.c Sim/sim_hal.c Src/bulk.c
+  *               Src/uart_dma.c Src/ring.c Src/rx_queue.c Src/stats.c
+  *
+  *         Usage:
+  *           ./bulkhost [baud] [slots] [request] [size] [total]
+  *             baud:    baud rate in bits/sec (10000000)
+  *             slots:   bulk IN transactions per 1 msec frame (19)
+  *             request: host read request in bytes, packet multiple (16384)
+  *             size:    DMA buffer size in bytes, at least 2 * USB_BULK_XFER_SIZE (DMA_BUF_SIZE)
+  *             total:   characters to send per pattern (1000000)
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usbd_cdc_if.h"
+#include "bulk.h"
+#include "sim.h"
+
+/* Only the configuration accepted by the firmware is simulated, main.h rejects USB_BULK_ENABLE without DMA_HT_ENABLE
+ * or with a DMA buffer shorter than two transfers */
+#if (USB_BULK_ENABLE == 0)
+#error "bulkhost requires the bulk configuration: set USB_BULK_ENABLE, DMA_HT_ENABLE and DMA_BUF_SIZE in main.h"
+#endif
+
+/* Defines -------------------------------------------------------------------*/
+#define PS_PER_SEC          1000000000000ULL
+#define PS_PER_MS           1000000000ULL
+#define NEVER               UINT64_MAX
+#define BURST_QUEUE         256     /* Bursts waiting for latency measurement */
+#define DRAIN_TIME_MS       200     /* Simulated time limit after the last character */
+
+/* Type definitions ----------------------------------------------------------*/
+typedef struct
+{
+    const char* name;
+    uint32_t burstMin;              /* Characters per burst, 0: continuous stream */
+    uint32_t burstMax;
+    uint32_t gapMin;                /* Idle line between bursts in percent of the DMA Timeout */
+    uint32_t gapMax;
+} Host_Pattern_t;
+
+typedef struct
+{
+    uint32_t baud;
+    uint32_t slots;
+    uint32_t request;
+    uint16_t size;
+    uint32_t total;
+} Host_Config_t;
+
+typedef struct
+{
+    uint64_t endIndex;              /* Stream index after the last character of the burst */
+    uint64_t endTime;               /* End of the stop bit of the last character */
+} Host_Burst_t;
+
+typedef struct
+{
+    uint64_t bytes;                 /* Bytes returned to the host application */
+    uint64_t corrupted;             /* Bytes with wrong content or out of order */
+    uint64_t stuck;                 /* Bytes left in an unterminated read request at the end */
+    uint64_t full;                  /* Full packets */
+    uint64_t partial;               /* Short packets with data */
+    uint64_t zlp;                   /* Zero-length packets */
+    uint64_t naks;                  /* Polls without transfer queued while a full packet was received */
+    uint64_t reads;                 /* Completed read requests */
+    uint64_t spurious;              /* ZLPs that do not end data: no full packet since the last short packet */
+    uint64_t firstSlot;             /* Slots from the first to the last data packet */
+    uint64_t lastSlot;
+    uint64_t time;                  /* Completion of the last read request */
+    uint64_t latencySum;
+    uint64_t latencyMax;
+    uint32_t latencyCount;
+} Host_Result_t;
+
+typedef struct
+{
+    uint8_t* buf;
+    uint16_t len;
+    uint8_t zlp;
+} Host_Xfer_t;
+
+/* Private variables ---------------------------------------------------------*/
+/* Bulk IN endpoint: queued transfers, the head one is in progress */
+static Host_Xfer_t ep_xfer[CDC_TX_QUEUE_SIZE];
+static uint32_t ep_head, ep_tail;
+static uint32_t ep_sent;                /* Bytes of the head transfer sent */
+static uint8_t ep_zlp;                  /* The data of the head transfer is sent, the ZLP is due */
+static uint32_t ep_queued;              /* Bytes queued since reset (free-running) */
+static uint32_t ep_invalid;             /* Transfers rejected because of invalid buffer */
+
+/* Host: one read request outstanding */
+static uint64_t host_index;             /* Stream index of the next byte expected */
+static uint32_t host_fill;              /* Bytes in the read request */
+static uint32_t host_open;              /* Bytes since the last short packet or ZLP */
+static Host_Burst_t host_burst[BURST_QUEUE];
+static uint32_t host_bHead, host_bTail;
+
+static uint32_t rng;                    /* xorshift32 state */
+
+/* Private function prototypes -----------------------------------------------*/
+static void Host_Run(const Host_Config_t* cfg, const Host_Pattern_t* pat, Host_Result_t* res);
+static void Host_Poll(const Host_Config_t* cfg, Host_Result_t* res, uint64_t now, uint64_t slot);
+static void Host_Complete(Host_Result_t* res, uint64_t now);
+static uint32_t Host_Random(uint32_t min, uint32_t max);
+
+/** Main function *************************************************************/
+int main(int argc, char* argv[])
+{
+    static const Host_Pattern_t patterns[] =
+    {
+        { "continuous",  0,     0,     0,   0   },  /* Saturation: one endless burst */
+        { "burst 4096",  4096,  4096,  200, 200 },  /* Bursts of packet multiple length: ZLP */
+        { "burst 64",    64,    64,    200, 200 },  /* Single full packets: ZLP */
+        { "burst 1000",  1000,  1000,  200, 200 },  /* Bursts ending with a short packet */
+        { "random",      1,     20000, 20,  400 },  /* Random bursts, gaps below and above the timeout */
+    };
+    Host_Config_t cfg;
+    Host_Result_t res;
+    uint32_t p, failed = 0;
+    uint64_t span;
+    uint8_t fail;
+
+    cfg.baud    = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+    cfg.slots   = (argc > 2) ? strtoul(argv[2], NULL, 0) : 19;
+    cfg.request = (argc > 3) ? strtoul(argv[3], NULL, 0) : 16384;
+    cfg.size    = (argc > 4) ? (uint16_t)strtoul(argv[4], NULL, 0) : DMA_BUF_SIZE;
+    cfg.total   = (argc > 5) ? strtoul(argv[5], NULL, 0) : 1000000;
+    if(cfg.baud == 0 || cfg.slots == 0 || cfg.request == 0 || (cfg.request % BULK_PACKET_SIZE) ||
+       cfg.size < 2 * USB_BULK_XFER_SIZE || cfg.size > SIM_BUF_MAX || (cfg.size & (cfg.size - 1)) || cfg.total == 0)
+    {
+        fprintf(stderr, "usage: %s [baud] [slots] [request] [size] [total]\n", argv[0]);
+        return 1;
+    }
+
+    printf("baud=%u slots=%u/ms (bus: %u B/s) request=%u size=%u xfer=%u total=%u\n",
+           cfg.baud, cfg.slots, cfg.slots * BULK_PACKET_SIZE * 1000, cfg.request, cfg.size,
+           USB_BULK_XFER_SIZE, cfg.total);
+    printf("%-11s %10s %6s %8s %7s %6s %5s %7s %5s %11s %11s\n",
+           "pattern", "bytes/s", "bus%", "full", "short", "zlp", "nak", "reads", "spur",
+           "lat.avg[us]", "lat.max[us]");
+
+    for(p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p)
+    {
+        Host_Run(&cfg, &patterns[p], &res);
+
+        span = res.lastSlot - res.firstSlot + 1;
+        fail = res.corrupted || res.stuck || res.spurious || res.naks || ep_invalid || res.bytes != cfg.total;
+        failed += fail;
+        printf("%-11s %10.0f %6.1f %8llu %7llu %6llu %5llu %7llu %5llu %11.1f %11.1f %s\n",
+               patterns[p].name,
+               res.time ? (double)res.bytes * PS_PER_SEC / res.time : 0.0,
+               100.0 * (res.full + res.partial) / span,
+               (unsigned long long)res.full, (unsigned long long)res.partial,
+               (unsigned long long)res.zlp, (unsigned long long)res.naks,
+               (unsigned long long)res.reads, (unsigned long long)res.spurious,
+               res.latencyCount ? (double)res.latencySum / res.latencyCount / 1e6 : 0.0,
+               (double)res.latencyMax / 1e6,
+               fail ? "FAIL" : "ok");
+        if(fail)
+        {
+            printf("  delivered=%llu corrupted=%llu stuck=%llu invalid=%u\n", (unsigned long long)res.bytes,
+                   (unsigned long long)res.corrupted, (unsigned long long)res.stuck, ep_invalid);
+        }
+    }
+
+    return failed ? 1 : 0;
+}
+
+/** Event driven simulation
+ * Simulated time is in picoseconds, the UART side is the same as in the benchmark (bench.c). In addition, the
+ * host polls the bulk IN endpoint in evenly spaced slots, the given number of times per 1 msec frame. The
+ * endpoint answers a poll with the next packet of the transfer in progress, with the ZLP that terminates it,
+ * or with NAK if no transfer is queued. The transfer complete interrupt is serviced right away, and PendSV
+ * runs after every interrupt. A read request of the host completes when it is full, or on a short packet or
+ * ZLP, and the flush latency of a burst is measured until the read request with its last byte completes.
+ * The test fails on wrong data, on data left in a read request that is never terminated, on a ZLP that does
+ * not follow a full packet, if the endpoint NAKs while a full packet of received data is waiting, or on a
+ * transfer without buffer. A read
+ * request that is filled up exactly by the data before a ZLP returns the ZLP as an empty read, like on a
+ * real host; this is counted in the reads only.
+*/
+static void Host_Run(const Host_Config_t* cfg, const Host_Pattern_t* pat, Host_Result_t* res)
+{
+    const Sim_Counters_t* cnt = Sim_GetCounters();
+    UART_DMA_t* ch;
+    uint64_t bitPs = PS_PER_SEC / cfg->baud;
+    uint64_t charPs = 10 * bitPs;
+    uint64_t slotPs = PS_PER_MS / cfg->slots;
+    uint64_t now = 0, end = NEVER;
+    uint64_t nextChar = charPs, nextTick = PS_PER_MS, nextSlot = slotPs, idleAt = NEVER, rtoAt = NEVER;
+    uint64_t slot = 0, tmoBits;
+    uint32_t burst, inBurst = 0;
+
+    DWT->CYCCNT = 0;
+    Sim_Reset(cfg->size, 12345);
+    Sim_SetSink(Bulk_Forward);
+    Bulk_Init();
+    ch = Sim_Channel();
+
+    ep_head = ep_tail = 0;
+    ep_sent = 0;
+    ep_zlp = 0;
+    ep_queued = 0;
+    ep_invalid = 0;
+    host_index = 0;
+    host_fill = 0;
+    host_open = 0;
+    host_bHead = host_bTail = 0;
+    rng = 0x9E3779B9U;
+    memset(res, 0, sizeof(*res));
+    res->firstSlot = NEVER;
+
+    tmoBits = (ch->engine == DMA_TIMEOUT_RTO) ? ch->timeout : (uint64_t)ch->timeout * cfg->baud / 1000;
+    burst = pat->burstMin ? Host_Random(pat->burstMin, pat->burstMax) : cfg->total;
+
+    while(now < end)
+    {
+        /* Next event */
+        now = (nextSlot < nextTick) ? nextSlot : nextTick;
+        if(cnt->sent < cfg->total && nextChar < now)
+        {
+            now = nextChar;
+        }
+        if(idleAt < now)
+        {
+            now = idleAt;
+        }
+        if(rtoAt < now)
+        {
+            now = rtoAt;
+        }
+        DWT->CYCCNT = (uint32_t)(now * (SystemCoreClock / 1000000) / 1000000);
+
+        if(cnt->sent < cfg->total && now == nextChar)
+        {
+            Sim_LineRx();
+            Sim_DmaIrq();
+            idleAt = now + charPs;
+            rtoAt = now + (uint64_t)(ch->huart.Instance->RTOR & USART_RTOR_RTO) * bitPs;
+
+            if(++inBurst == burst || cnt->sent == cfg->total)
+            {
+                if(host_bHead - host_bTail < BURST_QUEUE)
+                {
+                    host_burst[host_bHead % BURST_QUEUE].endIndex = cnt->sent;
+                    host_burst[host_bHead % BURST_QUEUE].endTime = now;
+                    ++host_bHead;
+                }
+                inBurst = 0;
+                burst = Host_Random(pat->burstMin, pat->burstMax);
+                nextChar = now + tmoBits * Host_Random(pat->gapMin, pat->gapMax) / 100 * bitPs + charPs;
+            }
+            else
+            {
+                nextChar = now + charPs;
+            }
+
+            if(cnt->sent == cfg->total)
+            {
+                end = now + DRAIN_TIME_MS * PS_PER_MS;
+            }
+        }
+        else if(now == idleAt)
+        {
+            idleAt = NEVER;
+            Sim_UartIdle();
+            if(rtoAt != NEVER)
+            {
+                rtoAt = now - charPs + (uint64_t)(ch->huart.Instance->RTOR & USART_RTOR_RTO) * bitPs;
+                rtoAt = (rtoAt < now) ? now : rtoAt;
+            }
+        }
+        else if(now == rtoAt)
+        {
+            rtoAt = NEVER;
+            Sim_UartRto();
+        }
+        else if(now == nextSlot)
+        {
+            nextSlot += slotPs;
+            Host_Poll(cfg, res, now, slot++);
+        }
+        else
+        {
+            nextTick += PS_PER_MS;
+            Sim_Tick();
+        }
+
+        Sim_PendSV();
+
+        if(res->bytes == cfg->total)
+        {
+            break;
+        }
+    }
+
+    /* Data returned to the host only with the next read request */
+    res->stuck = host_fill;
+}
+
+/* Poll of the bulk IN endpoint by the host: one packet of the transfer in progress */
+static void Host_Poll(const Host_Config_t* cfg, Host_Result_t* res, uint64_t now, uint64_t slot)
+{
+    Host_Xfer_t* x;
+    uint32_t len, k, done;
+
+    if(ep_head == ep_tail)
+    {
+        /* NAK: the sink has to keep a transfer queued while received data is waiting */
+        if(Sim_Channel()->rx.wr - ep_queued >= BULK_PACKET_SIZE)
+        {
+            ++res->naks;
+        }
+        return;
+    }
+
+    x = &ep_xfer[ep_head % CDC_TX_QUEUE_SIZE];
+    len = 0;
+    if(!ep_zlp)
+    {
+        len = x->len - ep_sent;
+        len = (len > BULK_PACKET_SIZE) ? BULK_PACKET_SIZE : len;
+    }
+
+    /* Packet received by the host */
+    for(k = 0; k < len; ++k)
+    {
+        if(x->buf[ep_sent + k] != Sim_StreamByte(host_index))
+        {
+            ++res->corrupted;
+        }
+        ++host_index;
+    }
+    ep_sent += len;
+    host_fill += len;
+
+    if(len == BULK_PACKET_SIZE)
+    {
+        ++res->full;
+    }
+    else if(len)
+    {
+        ++res->partial;
+    }
+    else
+    {
+        ++res->zlp;
+        if(host_open == 0)
+        {
+            ++res->spurious;
+        }
+    }
+    if(len)
+    {
+        res->firstSlot = (res->firstSlot == NEVER) ? slot : res->firstSlot;
+        res->lastSlot = slot;
+    }
+    host_open = (len == BULK_PACKET_SIZE) ? host_open + len : 0;
+
+    /* Read request complete on a short packet, ZLP or when full */
+    if(len < BULK_PACKET_SIZE || host_fill == cfg->request)
+    {
+        Host_Complete(res, now);
+    }
+
+    /* Transfer complete, unless its ZLP is due: the next one is started and the sink is notified */
+    if(ep_sent == x->len && !ep_zlp && x->zlp && x->len && (x->len % BULK_PACKET_SIZE) == 0)
+    {
+        ep_zlp = 1;
+        return;
+    }
+    if(ep_sent == x->len)
+    {
+        done = x->len;
+        ++ep_head;
+        ep_sent = 0;
+        ep_zlp = 0;
+        Bulk_TxCplt(done);
+    }
+}
+
+/* Read request of the host complete: the data is returned to the application */
+static void Host_Complete(Host_Result_t* res, uint64_t now)
+{
+    uint64_t latency;
+
+    ++res->reads;
+    res->bytes += host_fill;
+    res->time = now;
+    host_fill = 0;
+
+    /* Flush latency */
+    while(host_bTail != host_bHead && host_index >= host_burst[host_bTail % BURST_QUEUE].endIndex)
+    {
+        latency = now - host_burst[host_bTail % BURST_QUEUE].endTime;
+        res->latencySum += latency;
+        res->latencyCount++;
+        if(latency > res->latencyMax)
+        {
+            res->latencyMax = latency;
+        }
+        ++host_bTail;
+    }
+}
+
+/* Bulk IN transfer queued by the sink (stand-in of the CDC interface) */
+uint8_t CDC_TransmitBulk_FS(uint8_t* Buf, uint16_t Len, uint8_t zlp)
+{
+    Host_Xfer_t* x;
+
+    /* The endpoint start takes the buffer as the transfer address, also for a zero-length transfer */
+    if(Buf == NULL)
+    {
+        ++ep_invalid;
+        return USBD_FAIL;
+    }
+    if(ep_tail - ep_head == CDC_TX_QUEUE_SIZE)
+    {
+        return USBD_BUSY;
+    }
+    x = &ep_xfer[ep_tail % CDC_TX_QUEUE_SIZE];
+    x->buf = Buf;
+    x->len = Len;
+    x->zlp = zlp;
+    ++ep_tail;
+    ep_queued += Len;
+    return USBD_OK;
+}
+
+/* Uniform random number in [min, max] */
+static uint32_t Host_Random(uint32_t min, uint32_t max)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (max > min) ? min + rng % (max - min + 1) : min;
+}
@@ -0,0 +1,909 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   fuzz.c
+  * @brief  RX event interleaving fuzzer on the host
+  *         This file generates random interleavings of received characters,
+  *         DMA wraps, idle events, timeout expiries and deferred interrupt
+  *         service, replays them on the simulated RX engine and checks
+  *         byte-exact delivery. Every case is reproducible from its seed.
+  *
+  *         Build (from the repository root):
+  *           gcc -O2 -no-pie -Wno-pointer-to-int-cast -ISim -IInc -o fuzz
+  *               Sim/fuzz.c Sim/sim.c Sim/sim_hal.c
+  *               Src/uart_dma.c Src/ring.c Src/rx_queue.c Src/stats.c Src/scan.c
+  *               Src/crc.c Src/frame.c
+  *
+  *         Usage:
+  *           ./fuzz [cases] [seed]     run cases starting from seed
+  *           ./fuzz -r seed            replay one case with trace
+  *           ./fuzz -s [cases] [seed]  delimiter scanner cases starting from seed
+  *           ./fuzz -c [cases] [seed]  CRC cases starting from seed
+  *           ./fuzz -f [cases] [seed]  frame decoder cases starting from seed
+  *           ./fuzz -p                 worst-case patterns: cost per callback event
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "scan.h"
+#include "crc.h"
+#include "frame.h"
+#include "sim.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define FUZZ_STEPS          200     /* Operations per case */
+#define PATTERN_BYTES       1000000 /* Characters per worst-case pattern */
+#define SCAN_STEPS          400     /* Operations per scanner case */
+#define SCAN_STREAM_MAX     (SCAN_STEPS * 128)  /* Longest stream of a scanner case */
+#define SCAN_RECORDS        64      /* Records held by the scanner consumer */
+#define SCAN_DELIM          '\n'    /* Record delimiter of the scanner cases */
+#define CRC_DATA_MAX        300     /* Longest data of a CRC case */
+#define FRAME_ITEMS         32      /* Frames and error sequences per frame decoder case */
+#define FRAME_DATA_MAX      (FRAME_MAX_SIZE + 16)   /* Longest frame of a case: longer than the decoder buffer */
+#define FRAME_STREAM_MAX    (FRAME_ITEMS * (2 * FRAME_DATA_MAX + 16) + 1)  /* Encoded stream: all bytes escaped */
+
+/* Stream span not yet released by the consumer: pending gaps count, the DMA writes after them */
+#define FUZZ_PENDING(cnt)   ((cnt)->sent - (cnt)->discarded + (cnt)->gap - (cnt)->delivered - (cnt)->dropped)
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t rng;                    /* xorshift32 state */
+static uint8_t trace;                   /* Print operations */
+static uint32_t irqAge;                 /* Characters received since the DMA interrupt is pending */
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t Fuzz_Rand(uint32_t n);
+static uint8_t Fuzz_Case(uint32_t seed);
+static void Fuzz_Rx(uint32_t count, uint32_t latency);
+static void Fuzz_Service(void);
+static void Fuzz_Patterns(void);
+static double Fuzz_Timed(void (*fn)(void));
+static uint8_t Fuzz_ScanCase(uint32_t seed);
+static uint8_t Fuzz_ScanCheck(const RingSpan_t* span, uint8_t n, uint8_t flush);
+static uint8_t Fuzz_CrcCase(uint32_t seed);
+static uint32_t Fuzz_CrcBitwise(uint8_t width, const uint8_t* data, uint32_t len);
+static uint8_t Fuzz_FrameCase(uint32_t seed);
+static void Fuzz_FrameEncode(uint8_t codec, const uint8_t* data, uint32_t len);
+static void Fuzz_FramePut(uint8_t b);
+
+/** Main function *************************************************************/
+int main(int argc, char* argv[])
+{
+    uint32_t cases = 100000, seed = 1, i, failed = 0;
+    uint8_t (*run)(uint32_t) = Fuzz_Case;
+
+    if(argc > 1 && strcmp(argv[1], "-p") == 0)
+    {
+        Fuzz_Patterns();
+        return 0;
+    }
+    if(argc > 2 && strcmp(argv[1], "-r") == 0)
+    {
+        trace = 1;
+        return Fuzz_Case(strtoul(argv[2], NULL, 0)) ? 0 : 1;
+    }
+    if(argc > 1 && strcmp(argv[1], "-s") == 0)
+    {
+        run = Fuzz_ScanCase;
+        --argc;
+        ++argv;
+    }
+    else if(argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        run = Fuzz_CrcCase;
+        Crc_Init();
+        --argc;
+        ++argv;
+    }
+    else if(argc > 1 && strcmp(argv[1], "-f") == 0)
+    {
+        run = Fuzz_FrameCase;
+        --argc;
+        ++argv;
+    }
+    if(argc > 1)
+    {
+        cases = strtoul(argv[1], NULL, 0);
+    }
+    if(argc > 2)
+    {
+        seed = strtoul(argv[2], NULL, 0);
+    }
+
+    for(i = 0; i < cases; ++i)
+    {
+        if(!run(seed + i))
+        {
+            if(run == Fuzz_Case)
+            {
+                printf("FAIL seed=%u (replay: %s -r %u)\n", seed + i, argv[0], seed + i);
+            }
+            else
+            {
+                printf("FAIL seed=%u\n", seed + i);
+            }
+            if(++failed == 10)
+            {
+                break;
+            }
+        }
+    }
+
+    printf("%u cases, %u failed\n", i, failed);
+    return failed ? 1 : 0;
+}
+
+static uint32_t Fuzz_Rand(uint32_t n)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng % n;
+}
+
+/** Random case
+ * The DMA buffer size, the engine timeout and the sequence of operations are derived from the seed:
+ *  - R<n>: n characters received. The DMA interrupt is serviced after each character, or deferred
+ *          by up to one buffer length of characters (all interrupts have the same priority, an interrupt
+ *          can be delayed by the ones in progress), thus a timeout may be serviced before the DMA
+ *          Rx Complete interrupt of a wrap.
+ *  - D:    pending DMA interrupt serviced
+ *  - I:    idle line detected (only after reception)
+ *  - O:    receiver timeout expired (only after reception)
+ *  - T<n>: n SysTick periods elapsed, the DWT cycle counter advances as well (adaptive DMA Timeout)
+ *  - M:    pending character match interrupt serviced (DMA_MATCH_ENABLE)
+ *  - E<f>: character received with parity (P), framing (F) or noise (N) error, or overrun (O); the character is
+ *          discarded or replaced by the error mark (UART_ERROR_MARK)
+ *  - X:    DMA transfer error, the reception restarts at the next lap and the rest of the interrupted lap is skipped
+ *  - P:    PendSV worker runs (it may be deferred, so that events accumulate in the RX queue)
+ * The consumer releases everything it sees, and the generator never lets the unreleased data exceed
+ * the buffer size, thus every character (except the discarded ones) has to be delivered exactly once and in order.
+ * The stream indices skipped by DMA transfer errors (holes) have to be dropped by the consumer, nothing else.
+ * At the end of the case the line goes idle and the timeout has to flush the remaining data.
+*/
+static uint8_t Fuzz_Case(uint32_t seed)
+{
+    static const uint16_t sizes[] = { 4, 8, 16, 32, 64, 128 };
+    static const uint32_t errors[] = { USART_ISR_PE, USART_ISR_FE, USART_ISR_NE, USART_ISR_ORE };
+    const Sim_Counters_t* cnt = Sim_GetCounters();
+    uint32_t step, op, n;
+    uint8_t rxSinceIdle = 0, rxSinceRto = 0;
+    uint16_t size;
+
+    rng = seed * 2654435761U + 1;
+    size = sizes[Fuzz_Rand(sizeof(sizes) / sizeof(sizes[0]))];
+
+    Sim_Reset(size, seed);
+    irqAge = 0;
+    Sim_SetTimeout(1 + Fuzz_Rand((DMA_TIMEOUT_ENGINE == DMA_TIMEOUT_RTO) ? 100 : 5));
+    if(trace)
+    {
+        printf("seed=%u size=%u timeout=%u\n", seed, size, Sim_Channel()->timeout);
+    }
+
+    for(step = 0; step < FUZZ_STEPS; ++step)
+    {
+        op = Fuzz_Rand(10);
+        if(op < 4)
+        {
+            n = 1 + Fuzz_Rand(size + size / 2);
+            if(trace)
+            {
+                printf("R%u ", n);
+            }
+            Fuzz_Rx(n, Fuzz_Rand(size));
+            rxSinceIdle = rxSinceRto = 1;
+        }
+        else if(op == 4)
+        {
+            if(trace)
+            {
+                printf("D ");
+            }
+            Sim_DmaIrq();
+            irqAge = 0;
+        }
+        else if(op == 5 && rxSinceIdle)
+        {
+            if(trace)
+            {
+                printf("I ");
+            }
+            Sim_UartIdle();
+            rxSinceIdle = 0;
+        }
+        else if(op == 6 && rxSinceRto)
+        {
+            if(trace)
+            {
+                printf("O ");
+            }
+            Sim_UartRto();
+            rxSinceRto = 0;
+        }
+        else if(op == 7)
+        {
+            n = 1 + Fuzz_Rand(6);
+            if(trace)
+            {
+                printf("T%u ", n);
+            }
+            while(n--)
+            {
+                DWT->CYCCNT += SystemCoreClock / 1000;
+                Sim_Tick();
+            }
+        }
+#if (DMA_MATCH_ENABLE == 1)
+        else if(op == 8)
+        {
+            if(trace)
+            {
+                printf("M ");
+            }
+            Sim_UartMatch();
+        }
+#endif
+        else if(op == 9 && Fuzz_Rand(4) == 0)
+        {
+            if(trace)
+            {
+                printf("X ");
+            }
+            if(FUZZ_PENDING(cnt) >= size)
+            {
+                Fuzz_Service();
+            }
+            Sim_DmaError();
+            irqAge = 0;
+        }
+        else if(op == 9 && Fuzz_Rand(2))
+        {
+            n = Fuzz_Rand(4);
+            if(trace)
+            {
+                printf("E%c ", "PFNO"[n]);
+            }
+            if(FUZZ_PENDING(cnt) >= size)
+            {
+                Fuzz_Service();
+            }
+            Sim_LineError(errors[n]);
+            rxSinceIdle = rxSinceRto = 1;
+            /* The character is not counted by the DMA interrupt latency of Fuzz_Rx() */
+            if(Sim_DmaIrqPending())
+            {
+                Sim_DmaIrq();
+                irqAge = 0;
+            }
+        }
+        else
+        {
+            if(trace)
+            {
+                printf("P ");
+            }
+            Sim_PendSV();
+        }
+    }
+
+    /* End of transmission: every character has to be flushed */
+    Fuzz_Service();
+    if(rxSinceIdle)
+    {
+        Sim_UartIdle();
+    }
+    if(rxSinceRto)
+    {
+        Sim_UartRto();
+    }
+    for(n = 0; n <= Sim_Channel()->timeout && n < 1000; ++n)
+    {
+        Sim_Tick();
+    }
+    Sim_PendSV();
+
+    if(trace)
+    {
+        printf("\nsent=%llu delivered=%llu dropped=%llu corrupted=%llu discarded=%llu marked=%llu gap=%llu\n",
+               (unsigned long long)cnt->sent, (unsigned long long)cnt->delivered,
+               (unsigned long long)cnt->dropped, (unsigned long long)cnt->corrupted,
+               (unsigned long long)cnt->discarded, (unsigned long long)cnt->marked, (unsigned long long)cnt->gap);
+    }
+
+    return cnt->delivered == cnt->sent - cnt->discarded && cnt->dropped + Sim_Undelivered() == cnt->gap && cnt->corrupted == 0 && cnt->lost == 0;
+}
+
+/* Receive characters, the DMA interrupt is serviced with up to latency characters of delay */
+static void Fuzz_Rx(uint32_t count, uint32_t latency)
+{
+    const Sim_Counters_t* cnt = Sim_GetCounters();
+
+    while(count--)
+    {
+        /* The consumer has to catch up before the DMA overwrites unreleased data */
+        if(FUZZ_PENDING(cnt) >= Sim_Channel()->size)
+        {
+            Fuzz_Service();
+        }
+
+        Sim_LineRx();
+        if(Sim_DmaIrqPending() && irqAge++ >= latency)
+        {
+            Sim_DmaIrq();
+            irqAge = 0;
+        }
+    }
+}
+
+/* Service all pending interrupts and run the worker */
+static void Fuzz_Service(void)
+{
+    Sim_DmaIrq();
+    irqAge = 0;
+    Sim_PendSV();
+}
+
+/** Worst-case patterns
+ * Cost of the interrupt path (DMA, UART and SysTick interrupts with HAL_UART_RxCpltCallback) and of
+ * the worker per callback event, measured in host time around the serviced interrupts only (the
+ * worker time includes the byte-by-byte verification of the simulated consumer):
+ *  - 1-byte timeouts: every character is followed by an idle line and a timeout
+ *  - wrap + ignored timeout: every burst exactly fills the buffer (TC followed by an ignored timeout)
+ *  - split: bursts of 1.5 buffer length (TC and timeout per burst)
+ *  - stream: continuous reception, TC events only
+*/
+static void Fuzz_Patterns(void)
+{
+    static const char* names[] = { "1-byte timeouts", "wrap + ignored timeout", "split", "stream" };
+    const Sim_Counters_t* cnt;
+    uint16_t size = 64;
+    uint32_t p, burst, events, k;
+    double t;
+
+    printf("%-24s %10s %12s %12s %12s\n", "pattern", "events", "bytes/event", "ns/event", "MB/s");
+
+    for(p = 0; p < 4; ++p)
+    {
+        Sim_Reset(size, p);
+        Sim_SetTimeout(1);
+        cnt = Sim_GetCounters();
+        burst = (p == 0) ? 1 : (p == 1) ? size : (p == 2) ? size + size / 2 : PATTERN_BYTES;
+        t = 0;
+
+        while(cnt->sent < PATTERN_BYTES)
+        {
+            for(k = 0; k < burst && cnt->sent < PATTERN_BYTES; ++k)
+            {
+                Sim_LineRx();
+                if(Sim_DmaIrqPending())
+                {
+                    t += Fuzz_Timed(Sim_DmaIrq);
+                    t += Fuzz_Timed(Sim_PendSV);
+                }
+            }
+            t += Fuzz_Timed(Sim_UartIdle);
+            t += Fuzz_Timed(Sim_UartRto);
+            t += Fuzz_Timed(Sim_Tick);
+            t += Fuzz_Timed(Sim_Tick);
+            t += Fuzz_Timed(Sim_PendSV);
+        }
+
+        events = stats.tc_events + stats.ht_events + stats.timeout_events;
+        printf("%-24s %10u %12.2f %12.1f %12.2f%s\n", names[p], events,
+               (double)cnt->delivered / events, t * 1e9 / events, cnt->delivered / t / 1e6,
+               (cnt->delivered == cnt->sent && cnt->corrupted == 0) ? "" : "  DATA ERROR");
+    }
+}
+
+/* Host time of a call in seconds */
+static double Fuzz_Timed(void (*fn)(void))
+{
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    fn();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+}
+
+/** Delimiter scanner case
+ * The scanner runs over a ring of random size, whose storage starts at a random byte offset from a word
+ * boundary (like a DMA buffer without alignment attribute), with a random delimiter density (including none,
+ * so that the ring fills up without delimiter). The operations are derived from the seed:
+ *  - write: random number of stream bytes written into the ring (up to the free space)
+ *  - scan:  Scan_Next() until no record is complete, the records are kept by the consumer
+ *  - free:  the oldest records are released
+ *  - flush: the incomplete record is taken with Scan_Flush() (end of transmission)
+ *  - drop:  everything is released beyond the records (resynchronization), the scanner continues at the read index
+ * Every record has to continue the stream where the previous one ended and hold the stream bytes, with a single
+ * delimiter at its end. A record without delimiter is allowed for a flush, or if it fills the ring.
+*/
+static uint8_t scan_stream[SCAN_STREAM_MAX];
+static uint32_t scan_next;              /* Stream index expected at the start of the next record */
+static uint32_t scan_size;              /* Ring size of the case */
+
+static uint8_t Fuzz_ScanCase(uint32_t seed)
+{
+    static const uint16_t sizes[] = { 4, 8, 16, 32, 64, 128 };
+    static const uint32_t density[] = { 0, 2, 8, 40 };      /* One delimiter per n bytes on average, 0: none */
+    static uint32_t storage[(128 + 4) / 4];                 /* Word aligned, the ring starts at an offset */
+    uint32_t rec[SCAN_RECORDS];                             /* Lengths of the records held by the consumer */
+    uint32_t head = 0, tail = 0;
+    uint32_t step, op, n, k, len, wr = 0, d;
+    RingSpan_t span[2];
+    Ring_t r;
+    Scan_t scan;
+
+    rng = seed * 2654435761U + 1;
+    scan_size = sizes[Fuzz_Rand(sizeof(sizes) / sizeof(sizes[0]))];
+    d = density[Fuzz_Rand(sizeof(density) / sizeof(density[0]))];
+    Ring_Init(&r, (uint8_t*)storage + Fuzz_Rand(4), scan_size);
+    Scan_Init(&scan, SCAN_DELIM);
+    scan_next = 0;
+
+    for(step = 0; step < SCAN_STEPS; ++step)
+    {
+        op = Fuzz_Rand(10);
+        if(op < 4)
+        {
+            /* Write */
+            n = Fuzz_Rand(RING_FREE(&r) + 1);
+            for(k = 0; k < n && wr < SCAN_STREAM_MAX; ++k, ++wr)
+            {
+                scan_stream[wr] = (d && Fuzz_Rand(d) == 0) ? SCAN_DELIM : (uint8_t)(SCAN_DELIM + 1 + Fuzz_Rand(255));
+                Ring_Write(&r, &scan_stream[wr], 1);
+            }
+        }
+        else if(op < 7)
+        {
+            /* Scan */
+            while(tail - head < SCAN_RECORDS && (n = Scan_Next(&scan, &r, span)) != 0)
+            {
+                if(!Fuzz_ScanCheck(span, n, 0))
+                {
+                    return 0;
+                }
+                rec[tail++ % SCAN_RECORDS] = span[0].len + ((n == 2) ? span[1].len : 0);
+            }
+
+            /* Nothing complete left: no delimiter and room in the ring after the last record */
+            if(tail - head < SCAN_RECORDS)
+            {
+                for(k = scan_next; k < wr; ++k)
+                {
+                    if(scan_stream[k] == SCAN_DELIM)
+                    {
+                        return 0;
+                    }
+                }
+                if(wr - scan_next >= scan_size)
+                {
+                    return 0;
+                }
+            }
+        }
+        else if(op < 9)
+        {
+            /* Free */
+            n = Fuzz_Rand(tail - head + 1);
+            while(n--)
+            {
+                Ring_Release(&r, rec[head++ % SCAN_RECORDS]);
+            }
+        }
+        else if(Fuzz_Rand(4))
+        {
+            /* Flush */
+            while(tail - head < SCAN_RECORDS && (n = Scan_Next(&scan, &r, span)) != 0)
+            {
+                if(!Fuzz_ScanCheck(span, n, 0))
+                {
+                    return 0;
+                }
+                rec[tail++ % SCAN_RECORDS] = span[0].len + ((n == 2) ? span[1].len : 0);
+            }
+            if(tail - head < SCAN_RECORDS && (n = Scan_Flush(&scan, &r, span)) != 0)
+            {
+                if(!Fuzz_ScanCheck(span, n, 1))
+                {
+                    return 0;
+                }
+                rec[tail++ % SCAN_RECORDS] = span[0].len + ((n == 2) ? span[1].len : 0);
+            }
+        }
+        else
+        {
+            /* Drop */
+            Ring_Release(&r, RING_COUNT(&r));
+            head = tail;
+            scan_next = wr;
+        }
+    }
+
+    /* End of transmission: everything is returned */
+    while((n = Scan_Next(&scan, &r, span)) != 0 || (n = Scan_Flush(&scan, &r, span)) != 0)
+    {
+        if(!Fuzz_ScanCheck(span, n, 1))
+        {
+            return 0;
+        }
+        len = span[0].len + ((n == 2) ? span[1].len : 0);
+        Ring_Release(&r, len);
+    }
+    return scan_next == wr;
+}
+
+/* Verify a record against the stream, a record without delimiter is accepted for a flush or a full ring */
+static uint8_t Fuzz_ScanCheck(const RingSpan_t* span, uint8_t n, uint8_t flush)
+{
+    uint32_t len = 0, k, i;
+    uint8_t last = 0;
+
+    for(i = 0; i < n; ++i)
+    {
+        for(k = 0; k < span[i].len; ++k, ++len)
+        {
+            last = span[i].ptr[k];
+            if(last != scan_stream[scan_next + len] ||
+               (last == SCAN_DELIM && k + 1 < span[i].len) || (last == SCAN_DELIM && i + 1 < n))
+            {
+                return 0;
+            }
+        }
+    }
+
+    if(len == 0 || len > scan_size || (last != SCAN_DELIM && !flush && len != scan_size))
+    {
+        return 0;
+    }
+    scan_next += len;
+    return 1;
+}
+
+/** CRC case
+ * Crc_Update() is checked against the standard check values (CRC of "123456789": 0x906E for CRC-16/X.25,
+ * 0xCBF43926 for CRC-32) and against a bitwise reference on random data of random length, which starts at a
+ * random byte offset from a word boundary. The data is added in one call and in random pieces, both have to give
+ * the reference CRC, and the data followed by its check sequence (LSB first) has to be good.
+*/
+static uint8_t Fuzz_CrcCase(uint32_t seed)
+{
+    static const uint8_t check[] = "123456789";
+    static const uint8_t widths[] = { CRC_16, CRC_32 };
+    static uint32_t storage[(CRC_DATA_MAX + 4 + 4) / 4];    /* Word aligned, the data starts at an offset */
+    uint8_t* data;
+    uint32_t len, ref, fcs, pos, n, k, w;
+    Crc_t whole, split;
+
+    rng = seed * 2654435761U + 1;
+    data = (uint8_t*)storage + Fuzz_Rand(4);
+    len = Fuzz_Rand(CRC_DATA_MAX + 1);
+    for(k = 0; k < len; ++k)
+    {
+        data[k] = (uint8_t)Fuzz_Rand(256);
+    }
+
+    for(w = 0; w < sizeof(widths); ++w)
+    {
+        Crc_Start(&whole, widths[w]);
+        Crc_Update(&whole, check, sizeof(check) - 1);
+        if(Crc_Final(&whole) != ((widths[w] == CRC_16) ? 0x906EU : 0xCBF43926U))
+        {
+            return 0;
+        }
+
+        ref = Fuzz_CrcBitwise(widths[w], data, len);
+        Crc_Start(&whole, widths[w]);
+        Crc_Update(&whole, data, len);
+        Crc_Start(&split, widths[w]);
+        for(pos = 0; pos < len; pos += n)
+        {
+            n = Fuzz_Rand(len - pos + 1);
+            Crc_Update(&split, &data[pos], n);
+        }
+        if(Crc_Final(&whole) != ref || split.value != whole.value)
+        {
+            return 0;
+        }
+
+        /* Check sequence after the data */
+        fcs = Crc_Final(&whole);
+        for(k = 0; k < widths[w] / 8; ++k)
+        {
+            data[len + k] = (uint8_t)(fcs >> (8 * k));
+        }
+        Crc_Update(&whole, &data[len], widths[w] / 8);
+        if(!Crc_IsGood(&whole))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Reference CRC, one bit at a time (reflected polynomials, initial value and final XOR of all ones) */
+static uint32_t Fuzz_CrcBitwise(uint8_t width, const uint8_t* data, uint32_t len)
+{
+    const uint32_t poly = (width == CRC_16) ? 0x8408U : 0xEDB88320U;
+    const uint32_t mask = 0xFFFFFFFFU >> (32 - width);
+    uint32_t v = mask, k;
+
+    while(len--)
+    {
+        v ^= *data++;
+        for(k = 0; k < 8; ++k)
+        {
+            v = (v >> 1) ^ ((v & 1) ? poly : 0);
+        }
+    }
+    return v ^ mask;
+}
+
+/** Frame decoder case
+ * A stream of frames and error sequences is encoded with a random codec (COBS, SLIP or HDLC), check sequence
+ * (none, CRC-16 or CRC-32) and decoder buffer size, and decoded in random pieces, so that the pieces end
+ * anywhere in the frames, also inside the escape sequences. The items of the stream are derived from the seed:
+ *  - frame:     random data (biased towards the special characters of the codecs) with its check sequence,
+ *               also around the buffer size and longer than the buffer (dropped), empty without CRC (skipped)
+ *               and empty with CRC (too short, dropped)
+ *  - corrupted: a frame with a bit flipped in the data or in the check sequence (returned with FRAME_BAD_FCS)
+ *  - abort:     part of a frame followed by the abort sequence (SLIP, HDLC: escape and delimiter), a frame that
+ *               ends inside a COBS block, or an invalid SLIP escape followed by junk (dropped)
+ *  - empty:     consecutive delimiters (skipped)
+ * HDLC escapes random control characters as well (ACCM). Every result of the decoder has to match the next item: the
+ * data of the frames (check sequence removed), and a single FRAME_ERROR for every dropped item. The decoder
+ * buffer is swapped after every result, like the double buffer of the firmware.
+*/
+static uint8_t frame_stream[FRAME_STREAM_MAX];
+static uint32_t frame_wr;               /* Length of the encoded stream */
+static uint8_t frame_escapes;           /* HDLC: escape one of n control characters, 0: none */
+
+static uint8_t Fuzz_FrameCase(uint32_t seed)
+{
+    static const uint8_t codecs[] = { FRAME_COBS, FRAME_SLIP, FRAME_HDLC };
+    static const uint8_t crcs[] = { 0, CRC_16, CRC_32 };
+    static const uint16_t sizes[] = { 8, 16, 64, FRAME_MAX_SIZE };
+    static const uint8_t special[] = { 0x00, 0x01, 0xFF, 0xC0, 0xDB, 0xDC, 0xDD, 0x7E, 0x7D, 0x5E, 0x5D, 0x20 };
+    static uint8_t data[FRAME_ITEMS][FRAME_DATA_MAX + 4];  /* Expected frames, check sequence appended */
+    static uint8_t buf[2][FRAME_MAX_SIZE];
+    uint8_t result[FRAME_ITEMS];                            /* Expected results */
+    uint16_t len[FRAME_ITEMS];                              /* Expected frame lengths */
+    uint32_t items, item = 0, i, k, n, pos, used, fcs, density, code;
+    uint8_t codec, crc, op, r, which = 0;
+    uint16_t size;
+    Crc_t c;
+    Frame_t f;
+
+    rng = seed * 2654435761U + 1;
+    codec = codecs[Fuzz_Rand(sizeof(codecs))];
+    crc = crcs[Fuzz_Rand(sizeof(crcs))];
+    size = sizes[Fuzz_Rand(sizeof(sizes) / sizeof(sizes[0]))];
+    density = Fuzz_Rand(2) ? 4 : 0;                         /* Special character in one of n bytes, 0: none */
+    frame_escapes = (codec == FRAME_HDLC && Fuzz_Rand(2)) ? 8 : 0;
+    items = 1 + Fuzz_Rand(FRAME_ITEMS);
+    fcs = crc / 8;
+    frame_wr = 0;
+    Frame_Init(&f, codec, crc, buf[which], size);
+
+    /* HDLC and SLIP streams may start with a delimiter */
+    if(codec != FRAME_COBS && Fuzz_Rand(2))
+    {
+        Fuzz_FramePut((codec == FRAME_SLIP) ? 0xC0 : 0x7E);
+    }
+
+    for(i = 0; i < items; ++i)
+    {
+        op = Fuzz_Rand(10);
+        if(op < 8)
+        {
+            /* Frame: data till the buffer size, around the buffer size or beyond it, with its check sequence */
+            k = Fuzz_Rand(8);
+            n = (k == 0) ? size - fcs - 1 + Fuzz_Rand(4) : Fuzz_Rand(((k == 1) ? FRAME_DATA_MAX : size) - fcs + 1);
+            for(k = 0; k < n; ++k)
+            {
+                data[i][k] = (density && Fuzz_Rand(density) == 0) ? special[Fuzz_Rand(sizeof(special))]
+                                                                  : (uint8_t)Fuzz_Rand(256);
+            }
+            if(fcs)
+            {
+                Crc_Start(&c, crc);
+                Crc_Update(&c, data[i], n);
+                for(k = 0; k < fcs; ++k)
+                {
+                    data[i][n + k] = (uint8_t)(Crc_Final(&c) >> (8 * k));
+                }
+            }
+            if(n + fcs > size || (fcs && n == 0))
+            {
+                result[i] = FRAME_ERROR;
+            }
+            else if(n == 0)
+            {
+                /* Empty frame without CRC: skipped */
+                result[i] = FRAME_MORE;
+            }
+            else
+            {
+                result[i] = FRAME_DONE;
+                if(op >= 6 && fcs)
+                {
+                    /* Corrupted: one bit flipped in the data or in the check sequence */
+                    k = Fuzz_Rand((n + fcs) * 8);
+                    data[i][k / 8] ^= (uint8_t)(1U << (k % 8));
+                    result[i] = FRAME_BAD_FCS;
+                }
+            }
+            len[i] = (uint16_t)n;
+            Fuzz_FrameEncode(codec, data[i], n + fcs);
+        }
+        else if(op < 9)
+        {
+            /* Abort: part of a frame, not longer than the buffer */
+            result[i] = FRAME_ERROR;
+            n = Fuzz_Rand(size);
+            if(codec == FRAME_COBS)
+            {
+                /* The frame ends inside a block: at least one of the code - 1 data bytes is missing */
+                n = (n > 253) ? 253 : n;
+                code = n + 2 + Fuzz_Rand(254 - n);
+                Fuzz_FramePut((uint8_t)code);
+                for(k = 0; k < n; ++k)
+                {
+                    Fuzz_FramePut((uint8_t)(1 + Fuzz_Rand(255)));
+                }
+                Fuzz_FramePut(0x00);
+            }
+            else
+            {
+                for(k = 0; k < n; ++k)
+                {
+                    /* Characters that need no escape */
+                    Fuzz_FramePut((uint8_t)Fuzz_Rand(0x70));
+                }
+                if(codec == FRAME_SLIP && Fuzz_Rand(2))
+                {
+                    /* Invalid escape sequence, the rest is dropped till the delimiter */
+                    Fuzz_FramePut(0xDB);
+                    Fuzz_FramePut((uint8_t)Fuzz_Rand(0xC0));
+                    for(k = Fuzz_Rand(20); k > 0; --k)
+                    {
+                        Fuzz_FramePut((uint8_t)(0xDB + Fuzz_Rand(3)));
+                    }
+                    Fuzz_FramePut(0xC0);
+                }
+                else
+                {
+                    Fuzz_FramePut((codec == FRAME_SLIP) ? 0xDB : 0x7D);
+                    Fuzz_FramePut((codec == FRAME_SLIP) ? 0xC0 : 0x7E);
+                }
+            }
+        }
+        else
+        {
+            /* Empty frames */
+            result[i] = FRAME_MORE;
+            for(k = 1 + Fuzz_Rand(3); k > 0; --k)
+            {
+                Fuzz_FramePut((codec == FRAME_COBS) ? 0x00 : (codec == FRAME_SLIP) ? 0xC0 : 0x7E);
+            }
+        }
+    }
+
+    /* Decode in random pieces */
+    for(pos = 0; pos < frame_wr; pos += n)
+    {
+        n = Fuzz_Rand(Fuzz_Rand(2) ? 8 : 300);
+        if(n > frame_wr - pos)
+        {
+            n = frame_wr - pos;
+        }
+        for(k = 0; k < n; k += used)
+        {
+            r = Frame_Decode(&f, &frame_stream[pos + k], n - k, &used);
+            if(used > n - k || (r == FRAME_MORE && used != n - k))
+            {
+                return 0;
+            }
+            if(r == FRAME_MORE)
+            {
+                continue;
+            }
+
+            /* Next item with a result */
+            while(item < items && result[item] == FRAME_MORE)
+            {
+                ++item;
+            }
+            if(item == items || r != result[item])
+            {
+                return 0;
+            }
+            if(r != FRAME_ERROR && (f.buf != buf[which] || f.len != len[item] || memcmp(f.buf, data[item], f.len) != 0))
+            {
+                return 0;
+            }
+            ++item;
+
+            which ^= 1;
+            f.buf = buf[which];
+        }
+    }
+
+    /* Every item has been decoded */
+    while(item < items && result[item] == FRAME_MORE)
+    {
+        ++item;
+    }
+    return item == items;
+}
+
+/* Encode a frame with its delimiter */
+static void Fuzz_FrameEncode(uint8_t codec, const uint8_t* data, uint32_t len)
+{
+    uint32_t i, at;
+    uint8_t code, b;
+
+    if(codec == FRAME_COBS)
+    {
+        /* Blocks of up to 254 data bytes, the code byte is written when the block ends */
+        at = frame_wr;
+        Fuzz_FramePut(0);
+        code = 1;
+        for(i = 0; i < len; ++i)
+        {
+            if(data[i] == 0x00)
+            {
+                frame_stream[at] = code;
+                at = frame_wr;
+                Fuzz_FramePut(0);
+                code = 1;
+                continue;
+            }
+            Fuzz_FramePut(data[i]);
+            if(++code == 0xFF)
+            {
+                frame_stream[at] = code;
+                at = frame_wr;
+                Fuzz_FramePut(0);
+                code = 1;
+            }
+        }
+        frame_stream[at] = code;
+        Fuzz_FramePut(0x00);
+        return;
+    }
+
+    for(i = 0; i < len; ++i)
+    {
+        b = data[i];
+        if(codec == FRAME_SLIP)
+        {
+            if(b == 0xC0 || b == 0xDB)
+            {
+                Fuzz_FramePut(0xDB);
+                b = (b == 0xC0) ? 0xDC : 0xDD;
+            }
+        }
+        else if(b == 0x7E || b == 0x7D || (b < 0x20 && frame_escapes && Fuzz_Rand(frame_escapes) == 0))
+        {
+            Fuzz_FramePut(0x7D);
+            b ^= 0x20;
+        }
+        Fuzz_FramePut(b);
+    }
+    Fuzz_FramePut((codec == FRAME_SLIP) ? 0xC0 : 0x7E);
+}
+
+static void Fuzz_FramePut(uint8_t b)
+{
+    frame_stream[frame_wr++] = b;
+}
@@ -0,0 +1,425 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   sim.c
+  * @brief  Host simulation of the RX engine
+  *         This file models the UART receiver, the circular DMA channel,
+  *         SysTick and PendSV around the unmodified RX engine (uart_dma.c),
+  *         and a consumer that verifies the delivered data byte by byte.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "stats.h"
+#include "sim.h"
+
+/* Private variables ---------------------------------------------------------*/
+static UART_DMA_t sim_ch;
+static uint8_t sim_buf[SIM_BUF_MAX];    /* Static: address has to fit into CMAR */
+static Sim_Counters_t sim_cnt;
+static uint32_t sim_seed;
+static uint32_t sim_tick;
+static uint32_t sim_drain;              /* Consumer budget per tick, 0: unlimited */
+static uint32_t sim_budget;
+static uint64_t sim_expected;           /* Stream index of the next byte expected by the consumer */
+static uint64_t sim_mark[SIM_MARK_MAX]; /* Stream indices of the characters to be replaced by the error mark */
+
+/* Stream index of the next character written by the DMA */
+#define SIM_INDEX()         (sim_cnt.sent - sim_cnt.lost - sim_cnt.discarded + sim_cnt.gap)
+
+/* Private function prototypes -----------------------------------------------*/
+static void Sim_Sink(UART_DMA_t* ch);
+static void Sim_Consume(UART_DMA_t* ch, const uint8_t* ptr);
+static void Sim_UartIrq(void);
+static void Sim_DmaWrite(uint8_t error);
+static uint8_t Sim_IsMarked(uint64_t index);
+
+/**
+  * @brief  Reset the peripherals and restart the RX engine
+  * @param  size: DMA buffer size in bytes (at most SIM_BUF_MAX)
+  * @param  seed: seed of the data stream
+  * @retval None
+  */
+void Sim_Reset(uint16_t size, uint32_t seed)
+{
+    memset(sim_usart, 0, sizeof(sim_usart));
+    memset(sim_dma, 0, sizeof(sim_dma));
+    memset(&sim_scb, 0, sizeof(sim_scb));
+    memset(&sim_ch, 0, sizeof(sim_ch));
+    memset(&sim_cnt, 0, sizeof(sim_cnt));
+    memset(sim_buf, 0, sizeof(sim_buf));
+
+    sim_seed = seed;
+    sim_tick = 0;
+    sim_drain = 0;
+    sim_budget = 0;
+    sim_expected = 0;
+
+    Stats_Reset();
+    UART_DMA_Init(&sim_ch, SIM_PORT, UART_BAUDRATE, sim_buf, size, Sim_Sink);
+    UART_DMA_Start(&sim_ch);
+}
+
+/**
+  * @brief  Override the DMA Timeout duration
+  * @param  timeout: msec (SysTick engine) or bit-times (RTO engine)
+  * @retval None
+  */
+void Sim_SetTimeout(uint32_t timeout)
+{
+    sim_ch.timeout = timeout;
+    if(sim_ch.engine == DMA_TIMEOUT_RTO)
+    {
+        WRITE_REG(sim_ch.huart.Instance->RTOR, timeout & USART_RTOR_RTO);
+    }
+}
+
+/**
+  * @brief  Limit the consumer speed
+  * @param  bytesPerTick: bytes released per msec, 0: unlimited
+  * @retval None
+  */
+void Sim_SetDrain(uint32_t bytesPerTick)
+{
+    sim_drain = bytesPerTick;
+    sim_budget = bytesPerTick;
+}
+
+/**
+  * @brief  Replace the consumer of the channel, e.g. with a sink of the application
+  * @param  sink: consumer, NULL: the default consumer (byte by byte verification)
+  * @retval None
+  */
+void Sim_SetSink(UART_DMA_Sink_t sink)
+{
+    sim_ch.sink = (sink != NULL) ? sink : Sim_Sink;
+}
+
+UART_DMA_t* Sim_Channel(void)
+{
+    return &sim_ch;
+}
+
+const Sim_Counters_t* Sim_GetCounters(void)
+{
+    return &sim_cnt;
+}
+
+/* Stream indices after the last byte seen by the consumer (e.g. a hole of a DMA transfer error at the end) */
+uint64_t Sim_Undelivered(void)
+{
+    return SIM_INDEX() - sim_expected;
+}
+
+uint32_t Sim_GetTick(void)
+{
+    return sim_tick;
+}
+
+/* Content of the stream at index: hashed, so that misplaced data is detected */
+uint8_t Sim_StreamByte(uint64_t index)
+{
+    uint32_t x = (uint32_t)index ^ (uint32_t)(index >> 32) ^ sim_seed;
+
+    x ^= x >> 16;
+    x *= 0x7FEB352DU;
+    x ^= x >> 15;
+    x *= 0x846CA68BU;
+    x ^= x >> 16;
+    return (uint8_t)x;
+}
+
+/** UART receiver and circular DMA
+ * A character is received: the DMA writes it to the memory at (size - CNDTR) and decrements CNDTR.
+ * The Half Transfer and Transfer Complete flags are set, and CNDTR is reloaded in circular mode.
+ * The DMA interrupt is only made pending here, it is serviced with Sim_DmaIrq().
+ * The stream index counts the characters written by the DMA, characters lost or discarded by the UART
+ * do not take a stream index.
+*/
+void Sim_LineRx(void)
+{
+    DMA_Channel_TypeDef* dma = sim_ch.hdma_rx.Instance;
+
+    if((dma->CCR & DMA_CCR_EN) == 0 || (sim_ch.huart.Instance->CR3 & USART_CR3_DMAR) == 0)
+    {
+        ++sim_cnt.sent;
+        ++sim_cnt.lost;
+        return;
+    }
+    Sim_DmaWrite(0);
+}
+
+/** Character received with error, the UART error interrupt is serviced immediately
+ * Parity, framing or noise error:
+ *  - CR3.DDRE = 0: the character is not transferred by the DMA (discarded).
+ *  - CR3.DDRE = 1: the DMA request is masked while the error flag is set, the character is transferred when
+ *    the handler clears the flag; the consumer has to see the error mark at its stream index.
+ * Overrun: the character is lost.
+*/
+void Sim_LineError(uint32_t flags)
+{
+    USART_TypeDef* uart = sim_ch.huart.Instance;
+
+    /* Only the last write to ICR is modelled: a pending character match is serviced first */
+    Sim_UartMatch();
+
+    uart->ISR |= flags;
+    if((flags & (USART_ISR_PE | USART_ISR_FE | USART_ISR_NE)) && (uart->CR3 & USART_CR3_DDRE))
+    {
+        uart->ISR |= USART_ISR_RXNE;
+        sim_mark[sim_cnt.marked++ % SIM_MARK_MAX] = SIM_INDEX();
+    }
+    else
+    {
+        ++sim_cnt.sent;
+        ++sim_cnt.discarded;
+    }
+
+    if(uart->CR3 & USART_CR3_EIE)
+    {
+        Sim_UartIrq();
+    }
+}
+
+/** DMA transfer error, the pending DMA interrupts are serviced first
+ * The channel is disabled and its flags are cleared by the HAL, which ends the reception and reports the error.
+ * The engine restarts the DMA at the next lap: the stream index skips the rest of the interrupted lap (hole),
+ * these indices are never written and the consumer has to skip them (counted as dropped).
+*/
+void Sim_DmaError(void)
+{
+    DMA_Channel_TypeDef* dma = sim_ch.hdma_rx.Instance;
+
+    Sim_DmaIrq();
+    dma->CCR &= ~DMA_CCR_EN;
+    dma->flags = 0;
+    sim_cnt.gap += dma->CNDTR % sim_ch.size;
+    HAL_UART_ErrorCallback(&sim_ch.huart);
+}
+
+/* DMA transfer of the received character, a character with error is corrupted */
+static void Sim_DmaWrite(uint8_t error)
+{
+    DMA_Channel_TypeDef* dma = sim_ch.hdma_rx.Instance;
+    uint16_t size = sim_ch.size;
+    uint8_t* mem = (uint8_t*)(uintptr_t)dma->CMAR;
+
+    mem[size - dma->CNDTR] = Sim_StreamByte(SIM_INDEX()) ^ (error ? 0xA5 : 0x00);
+    ++sim_cnt.sent;
+
+    /* Character match: the interrupt is only made pending here, it is serviced with Sim_UartMatch() */
+    if(mem[size - dma->CNDTR] == ((sim_ch.huart.Instance->CR2 & USART_CR2_ADD) >> USART_CR2_ADD_Pos))
+    {
+        sim_ch.huart.Instance->ISR |= USART_ISR_CMF;
+    }
+
+    --dma->CNDTR;
+    if(size - dma->CNDTR == size / 2)
+    {
+        dma->flags |= DMA_FLAG_HT;
+    }
+    if(dma->CNDTR == 0)
+    {
+        dma->flags |= DMA_FLAG_TC;
+        if(dma->CCR & DMA_CCR_CIRC)
+        {
+            dma->CNDTR = size;
+        }
+        else
+        {
+            dma->CCR &= ~DMA_CCR_EN;
+        }
+    }
+}
+
+uint8_t Sim_DmaIrqPending(void)
+{
+    DMA_Channel_TypeDef* dma = sim_ch.hdma_rx.Instance;
+
+    return ((dma->flags & DMA_FLAG_HT) && (dma->CCR & DMA_CCR_HTIE)) ||
+           ((dma->flags & DMA_FLAG_TC) && (dma->CCR & DMA_CCR_TCIE));
+}
+
+/* Service the DMA interrupt until no flag is pending */
+void Sim_DmaIrq(void)
+{
+    while(Sim_DmaIrqPending())
+    {
+        UART_DMA_RxIRQHandler(SIM_PORT);
+    }
+}
+
+/* Idle line detected (one character time without reception) */
+void Sim_UartIdle(void)
+{
+    USART_TypeDef* uart = sim_ch.huart.Instance;
+
+    uart->ISR |= USART_ISR_IDLE;
+    if(uart->CR1 & USART_CR1_IDLEIE)
+    {
+        Sim_UartIrq();
+    }
+}
+
+/* Service the pending character match interrupt */
+void Sim_UartMatch(void)
+{
+    USART_TypeDef* uart = sim_ch.huart.Instance;
+
+    if((uart->ISR & USART_ISR_CMF) && (uart->CR1 & USART_CR1_CMIE))
+    {
+        Sim_UartIrq();
+    }
+}
+
+/* Receiver timeout expired (RTOR bit-times without reception) */
+void Sim_UartRto(void)
+{
+    USART_TypeDef* uart = sim_ch.huart.Instance;
+
+    if((uart->CR2 & USART_CR2_RTOEN) == 0)
+    {
+        return;
+    }
+    uart->ISR |= USART_ISR_RTOF;
+    if(uart->CR1 & USART_CR1_RTOIE)
+    {
+        Sim_UartIrq();
+    }
+}
+
+/* UART interrupt: flags written to ICR are cleared after the handler, a character held by the error flag
+ * (CR3.DDRE) is transferred by the DMA then */
+static void Sim_UartIrq(void)
+{
+    USART_TypeDef* uart = sim_ch.huart.Instance;
+
+    UART_DMA_IRQHandler(SIM_PORT);
+    uart->ISR &= ~uart->ICR;
+    uart->ICR = 0;
+
+    if((uart->ISR & USART_ISR_RXNE) && (uart->ISR & (USART_ISR_PE | USART_ISR_FE | USART_ISR_NE)) == 0)
+    {
+        uart->ISR &= ~USART_ISR_RXNE;
+        Sim_DmaWrite(1);
+    }
+}
+
+/* SysTick: 1 msec */
+void Sim_Tick(void)
+{
+    ++sim_tick;
+    UART_DMA_TickHandler();
+
+    if(sim_drain)
+    {
+        sim_budget = sim_drain;
+        if(RING_COUNT(&sim_ch.rx))
+        {
+            UART_DMA_Schedule();
+        }
+    }
+}
+
+/* PendSV: the RX worker runs after the interrupts */
+void Sim_PendSV(void)
+{
+    while(sim_scb.ICSR & SCB_ICSR_PENDSVSET_Msk)
+    {
+        sim_scb.ICSR &= ~SCB_ICSR_PENDSVSET_Msk;
+        UART_DMA_Process();
+    }
+}
+
+/* Consumer: verify and release the received data, limited by the drain budget */
+static void Sim_Sink(UART_DMA_t* ch)
+{
+    DMA_Span_t span[2];
+    uint8_t n, i;
+    uint32_t k, len;
+    uint32_t total;
+#if (UART_DMA_STAMP == 1)
+    RxChunk_t chunk;
+
+    /* Chunk by chunk, as the timestamped records */
+    while((n = UART_DMA_GetStamped(ch, span, &chunk)) != 0 && (sim_drain == 0 || sim_budget))
+#else
+    n = UART_DMA_GetSpans(ch, span);
+#endif
+    {
+        total = 0;
+        for(i = 0; i < n; ++i)
+        {
+            len = span[i].len;
+            if(sim_drain && total + len > sim_budget)
+            {
+                len = sim_budget - total;
+            }
+            for(k = 0; k < len; ++k)
+            {
+                Sim_Consume(ch, &span[i].ptr[k]);
+            }
+            total += len;
+        }
+
+        UART_DMA_Release(ch, total);
+        if(sim_drain)
+        {
+            sim_budget -= total;
+        }
+    }
+    if(RING_COUNT(&ch->rx) == 0)
+    {
+        ch->flush = 0;
+    }
+}
+
+/** Byte-exact verification
+ * The stream index of a delivered byte is the smallest index >= expected, that maps to the same
+ * DMA buffer position and has the same content. Skipped indices are dropped (consumer overrun),
+ * a byte without such index is corrupted.
+*/
+static void Sim_Consume(UART_DMA_t* ch, const uint8_t* ptr)
+{
+    uint16_t size = ch->size;
+    uint64_t pos = (uint64_t)(ptr - ch->buf);
+    uint64_t index = sim_expected + (pos + size - (sim_expected % size)) % size;
+
+    ++sim_cnt.delivered;
+
+    while(index < SIM_INDEX() && Sim_StreamByte(index) != *ptr &&
+          !(*ptr == UART_ERROR_MARKER && Sim_IsMarked(index)))
+    {
+        index += size;
+    }
+
+    if(index >= SIM_INDEX())
+    {
+        ++sim_cnt.corrupted;
+        ++sim_expected;
+        return;
+    }
+
+    sim_cnt.dropped += index - sim_expected;
+    sim_expected = index + 1;
+}
+
+/* Stream index of a character replaced by the error mark (among the last SIM_MARK_MAX ones) */
+static uint8_t Sim_IsMarked(uint64_t index)
+{
+    uint64_t i = (sim_cnt.marked > SIM_MARK_MAX) ? sim_cnt.marked - SIM_MARK_MAX : 0;
+
+    for(; i < sim_cnt.marked; ++i)
+    {
+        if(sim_mark[i % SIM_MARK_MAX] == index)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef __SIM_H
+#define __SIM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "uart_dma.h"
+
+/* Defines -------------------------------------------------------------------*/
+#define SIM_PORT            UART_DMA_USART2     /* Simulated serial port */
+#define SIM_BUF_MAX         32768               /* Largest simulated DMA buffer in bytes */
+#define SIM_MARK_MAX        256                 /* Marked characters remembered for verification */
+
+/* Type definitions ----------------------------------------------------------*/
+typedef struct
+{
+    uint64_t sent;              /* Characters received on the line */
+    uint64_t delivered;         /* Bytes seen by the consumer */
+    uint64_t dropped;           /* Bytes skipped because the consumer was overrun */
+    uint64_t corrupted;         /* Bytes delivered with wrong content or out of order */
+    uint64_t lost;              /* Characters lost because the DMA was not running */
+    uint64_t discarded;         /* Characters received with error and not transferred (or lost by overrun) */
+    uint64_t marked;            /* Characters received with error and replaced by the error mark */
+    uint64_t gap;               /* Stream indices skipped by DMA transfer errors (holes) */
+} Sim_Counters_t;
+
+/* Exported functions --------------------------------------------------------*/
+void Sim_Reset(uint16_t size, uint32_t seed);
+void Sim_SetTimeout(uint32_t timeout);
+void Sim_SetDrain(uint32_t bytesPerTick);
+void Sim_SetSink(UART_DMA_Sink_t sink);
+UART_DMA_t* Sim_Channel(void);
+const Sim_Counters_t* Sim_GetCounters(void);
+uint64_t Sim_Undelivered(void);
+uint8_t Sim_StreamByte(uint64_t index);
+
+/* Stimulus: hardware events, the corresponding interrupts are serviced explicitly */
+void Sim_LineRx(void);
+uint8_t Sim_DmaIrqPending(void);
+void Sim_DmaIrq(void);
+void Sim_UartIdle(void);
+void Sim_UartRto(void);
+void Sim_UartMatch(void);
+void Sim_LineError(uint32_t flags);
+void Sim_DmaError(void);
+void Sim_Tick(void);
+void Sim_PendSV(void);
+uint32_t Sim_GetTick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_H */
@@ -0,0 +1,198 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   sim_hal.c
+  * @brief  Host stand-in of the HAL
+  *         This file contains the HAL functions used by the RX engine,
+  *         operating on the simulated peripheral registers.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "stm32l4xx_hal.h"
+#include "sim.h"
+
+/* Peripherals ---------------------------------------------------------------*/
+USART_TypeDef sim_usart[6];
+DMA_Channel_TypeDef sim_dma[2][7];
+SCB_Type sim_scb;
+DWT_Type sim_dwt;
+CoreDebug_Type sim_coredebug;
+uint32_t SystemCoreClock = 48000000;
+
+static uint32_t sim_primask;
+
+/* Private function prototypes -----------------------------------------------*/
+static void UART_DMAReceiveCplt(DMA_HandleTypeDef* hdma);
+static void UART_DMARxHalfCplt(DMA_HandleTypeDef* hdma);
+
+/* Core ----------------------------------------------------------------------*/
+uint32_t __get_PRIMASK(void)
+{
+    return sim_primask;
+}
+
+void __set_PRIMASK(uint32_t primask)
+{
+    sim_primask = primask;
+}
+
+void __disable_irq(void)
+{
+    sim_primask = 1;
+}
+
+void __enable_irq(void)
+{
+    sim_primask = 0;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return Sim_GetTick();
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+}
+
+void Error_Handler(void)
+{
+    fprintf(stderr, "Error_Handler() called\n");
+    exit(1);
+}
+
+/* DMA -----------------------------------------------------------------------*/
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma)
+{
+    hdma->Instance->CCR = hdma->Init.Mode | hdma->Init.Direction;
+    hdma->Instance->flags = 0;
+    hdma->State = HAL_DMA_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+    if(hdma->Init.Direction == DMA_MEMORY_TO_PERIPH)
+    {
+        hdma->Instance->CPAR = DstAddress;
+        hdma->Instance->CMAR = SrcAddress;
+    }
+    else
+    {
+        hdma->Instance->CPAR = SrcAddress;
+        hdma->Instance->CMAR = DstAddress;
+    }
+    hdma->Instance->CNDTR = DataLength;
+    hdma->Instance->CCR |= DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_TEIE;
+    if(hdma->XferHalfCpltCallback != NULL)
+    {
+        hdma->Instance->CCR |= DMA_CCR_HTIE;
+    }
+    else
+    {
+        hdma->Instance->CCR &= ~DMA_CCR_HTIE;
+    }
+    hdma->State = HAL_DMA_STATE_BUSY;
+    return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef* hdma)
+{
+    DMA_Channel_TypeDef* dma = hdma->Instance;
+
+    if((dma->flags & DMA_FLAG_HT) && (dma->CCR & DMA_CCR_HTIE))
+    {
+        dma->flags &= ~DMA_FLAG_HT;
+        if(hdma->XferHalfCpltCallback != NULL)
+        {
+            hdma->XferHalfCpltCallback(hdma);
+        }
+    }
+    else if((dma->flags & DMA_FLAG_TC) && (dma->CCR & DMA_CCR_TCIE))
+    {
+        if((dma->CCR & DMA_CCR_CIRC) == 0)
+        {
+            dma->CCR &= ~(DMA_CCR_TCIE | DMA_CCR_TEIE);
+            hdma->State = HAL_DMA_STATE_READY;
+        }
+        dma->flags &= ~DMA_FLAG_TC;
+        if(hdma->XferCpltCallback != NULL)
+        {
+            hdma->XferCpltCallback(hdma);
+        }
+    }
+}
+
+/* UART ----------------------------------------------------------------------*/
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart)
+{
+    huart->Instance->CR1 = USART_CR1_UE | USART_CR1_RE | USART_CR1_TE;
+    huart->Instance->ISR = USART_ISR_TC | USART_ISR_TXE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    return UART_SetConfig(huart);
+}
+
+HAL_StatusTypeDef UART_SetConfig(UART_HandleTypeDef* huart)
+{
+    if(huart->Init.BaudRate == 0 || (SystemCoreClock / huart->Init.BaudRate) < 16)
+    {
+        return HAL_ERROR;
+    }
+    huart->Instance->BRR = SystemCoreClock / huart->Init.BaudRate;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size)
+{
+    DMA_HandleTypeDef* hdma = huart->hdmarx;
+
+    huart->pRxBuffPtr = pData;
+    huart->RxXferSize = Size;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+    hdma->XferCpltCallback = UART_DMAReceiveCplt;
+    hdma->XferHalfCpltCallback = UART_DMARxHalfCplt;
+    HAL_DMA_Start_IT(hdma, (uint32_t)(uintptr_t)&huart->Instance->RDR, (uint32_t)(uintptr_t)pData, Size);
+
+    SET_BIT(huart->Instance->CR1, USART_CR1_PEIE);
+    SET_BIT(huart->Instance->CR3, USART_CR3_EIE | USART_CR3_DMAR);
+    return HAL_OK;
+}
+
+static void UART_DMAReceiveCplt(DMA_HandleTypeDef* hdma)
+{
+    HAL_UART_RxCpltCallback((UART_HandleTypeDef*)hdma->Parent);
+}
+
+static void UART_DMARxHalfCplt(DMA_HandleTypeDef* hdma)
+{
+    HAL_UART_RxHalfCpltCallback((UART_HandleTypeDef*)hdma->Parent);
+}
+
+__weak void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+}
+
+__weak void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+}
+
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+}
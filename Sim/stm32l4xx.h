@@ -0,0 +1,195 @@
+#ifndef __STM32L4xx_H
+#define __STM32L4xx_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Host stand-in of the STM32L4 device header
+ * Only the registers, bits and core functions used by the RX engine are defined.
+ * The peripherals are plain memory, their behavior is modelled by sim.c.
+ * The DMA address registers are 32-bit as on the target, therefore the simulator has to be linked
+ * as a non-PIE executable (-no-pie) so that the addresses of static buffers fit into 32 bits.
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+/* Compiler abstraction ------------------------------------------------------*/
+#define __IO                volatile
+#define __weak              __attribute__((weak))
+#define __DMB()             __sync_synchronize()
+#define __DSB()             __sync_synchronize()
+#define __CLZ(__X__)        ((uint32_t)__builtin_clz(__X__))
+
+/* Interrupt masking is modelled by the simulator */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+/* Bit manipulation ----------------------------------------------------------*/
+#define SET_BIT(REG, BIT)       ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)     ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)      ((REG) & (BIT))
+#define WRITE_REG(REG, VAL)     ((REG) = (VAL))
+#define READ_REG(REG)           ((REG))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)  WRITE_REG((REG), (((READ_REG(REG)) & (~(CLEARMASK))) | (SETMASK)))
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus, ITStatus;
+
+/* Interrupt numbers ---------------------------------------------------------*/
+typedef enum
+{
+    PendSV_IRQn         = -2,
+    SysTick_IRQn        = -1,
+    DMA1_Channel1_IRQn  = 11,
+    DMA1_Channel2_IRQn  = 12,
+    DMA1_Channel3_IRQn  = 13,
+    DMA1_Channel4_IRQn  = 14,
+    DMA1_Channel5_IRQn  = 15,
+    DMA1_Channel6_IRQn  = 16,
+    DMA1_Channel7_IRQn  = 17,
+    USART1_IRQn         = 37,
+    USART2_IRQn         = 38,
+    USART3_IRQn         = 39,
+    UART4_IRQn          = 52,
+    UART5_IRQn          = 53,
+    DMA2_Channel1_IRQn  = 56,
+    DMA2_Channel2_IRQn  = 57,
+    DMA2_Channel3_IRQn  = 58,
+    DMA2_Channel5_IRQn  = 60,
+    DMA2_Channel6_IRQn  = 68,
+    DMA2_Channel7_IRQn  = 69,
+    LPUART1_IRQn        = 70
+} IRQn_Type;
+
+/* Peripheral registers ------------------------------------------------------*/
+typedef struct
+{
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint32_t BRR;
+    __IO uint32_t GTPR;
+    __IO uint32_t RTOR;
+    __IO uint32_t RQR;
+    __IO uint32_t ISR;
+    __IO uint32_t ICR;
+    __IO uint32_t RDR;
+    __IO uint32_t TDR;
+} USART_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+    __IO uint32_t CPAR;
+    __IO uint32_t CMAR;
+    __IO uint32_t flags;            /* Simulator: pending DMA_FLAG_xxx of the channel */
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+    __IO uint32_t ICSR;
+} SCB_Type;
+
+typedef struct
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+/* Peripheral instances, defined by the simulator */
+extern USART_TypeDef sim_usart[6];
+extern DMA_Channel_TypeDef sim_dma[2][7];
+extern SCB_Type sim_scb;
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_coredebug;
+
+#define USART1              (&sim_usart[0])
+#define USART2              (&sim_usart[1])
+#define USART3              (&sim_usart[2])
+#define UART4               (&sim_usart[3])
+#define UART5               (&sim_usart[4])
+#define LPUART1             (&sim_usart[5])
+
+#define DMA1_Channel1       (&sim_dma[0][0])
+#define DMA1_Channel2       (&sim_dma[0][1])
+#define DMA1_Channel3       (&sim_dma[0][2])
+#define DMA1_Channel4       (&sim_dma[0][3])
+#define DMA1_Channel5       (&sim_dma[0][4])
+#define DMA1_Channel6       (&sim_dma[0][5])
+#define DMA1_Channel7       (&sim_dma[0][6])
+#define DMA2_Channel1       (&sim_dma[1][0])
+#define DMA2_Channel2       (&sim_dma[1][1])
+#define DMA2_Channel3       (&sim_dma[1][2])
+#define DMA2_Channel4       (&sim_dma[1][3])
+#define DMA2_Channel5       (&sim_dma[1][4])
+#define DMA2_Channel6       (&sim_dma[1][5])
+#define DMA2_Channel7       (&sim_dma[1][6])
+
+#define SCB                 (&sim_scb)
+#define DWT                 (&sim_dwt)
+#define CoreDebug           (&sim_coredebug)
+
+/* Register bits -------------------------------------------------------------*/
+#define USART_CR1_UE                (1UL << 0)
+#define USART_CR1_RE                (1UL << 2)
+#define USART_CR1_TE                (1UL << 3)
+#define USART_CR1_IDLEIE            (1UL << 4)
+#define USART_CR1_RXNEIE            (1UL << 5)
+#define USART_CR1_TCIE              (1UL << 6)
+#define USART_CR1_PEIE              (1UL << 8)
+#define USART_CR1_CMIE              (1UL << 14)
+#define USART_CR1_RTOIE             (1UL << 26)
+
+#define USART_CR2_ADD_Pos           24U
+#define USART_CR2_ADD               (0xFFUL << USART_CR2_ADD_Pos)
+#define USART_CR2_RTOEN             (1UL << 23)
+
+#define USART_CR3_EIE               (1UL << 0)
+#define USART_CR3_DMAR              (1UL << 6)
+#define USART_CR3_DMAT              (1UL << 7)
+#define USART_CR3_DDRE              (1UL << 13)
+
+#define USART_RTOR_RTO              0x00FFFFFFUL
+
+#define USART_ISR_PE                (1UL << 0)
+#define USART_ISR_FE                (1UL << 1)
+#define USART_ISR_NE                (1UL << 2)
+#define USART_ISR_ORE               (1UL << 3)
+#define USART_ISR_IDLE              (1UL << 4)
+#define USART_ISR_RXNE              (1UL << 5)
+#define USART_ISR_TC                (1UL << 6)
+#define USART_ISR_TXE               (1UL << 7)
+#define USART_ISR_RTOF              (1UL << 11)
+#define USART_ISR_CMF               (1UL << 17)
+
+#define DMA_CCR_EN                  (1UL << 0)
+#define DMA_CCR_TCIE                (1UL << 1)
+#define DMA_CCR_HTIE                (1UL << 2)
+#define DMA_CCR_TEIE                (1UL << 3)
+#define DMA_CCR_DIR                 (1UL << 4)
+#define DMA_CCR_CIRC                (1UL << 5)
+#define DMA_CCR_MEM2MEM             (1UL << 14)
+
+#define SCB_ICSR_PENDSVSET_Msk      (1UL << 28)
+#define SCB_ICSR_PENDSVCLR_Msk      (1UL << 27)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+
+/* System clock --------------------------------------------------------------*/
+extern uint32_t SystemCoreClock;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32L4xx_H */
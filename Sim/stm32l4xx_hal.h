@@ -0,0 +1,196 @@
+#ifndef __STM32L4xx_HAL_H
+#define __STM32L4xx_HAL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Host stand-in of the STM32L4 HAL
+ * Only the types, constants and functions used by the RX engine are defined.
+ * The functions are implemented in sim_hal.c.
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32l4xx.h"
+
+/* Type definitions ----------------------------------------------------------*/
+typedef enum
+{
+    HAL_OK      = 0x00,
+    HAL_ERROR   = 0x01,
+    HAL_BUSY    = 0x02,
+    HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    HAL_UNLOCKED = 0x00,
+    HAL_LOCKED   = 0x01
+} HAL_LockTypeDef;
+
+typedef enum
+{
+    HAL_DMA_STATE_RESET = 0x00,
+    HAL_DMA_STATE_READY = 0x01,
+    HAL_DMA_STATE_BUSY  = 0x02
+} HAL_DMA_StateTypeDef;
+
+typedef struct
+{
+    uint32_t Request;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+    DMA_Channel_TypeDef*        Instance;
+    DMA_InitTypeDef             Init;
+    HAL_LockTypeDef             Lock;
+    __IO HAL_DMA_StateTypeDef   State;
+    void*                       Parent;
+    void (* XferCpltCallback)(struct __DMA_HandleTypeDef* hdma);
+    void (* XferHalfCpltCallback)(struct __DMA_HandleTypeDef* hdma);
+    void (* XferErrorCallback)(struct __DMA_HandleTypeDef* hdma);
+    void (* XferAbortCallback)(struct __DMA_HandleTypeDef* hdma);
+    __IO uint32_t               ErrorCode;
+} DMA_HandleTypeDef;
+
+typedef enum
+{
+    HAL_UART_STATE_RESET    = 0x00,
+    HAL_UART_STATE_READY    = 0x20,
+    HAL_UART_STATE_BUSY     = 0x24,
+    HAL_UART_STATE_BUSY_TX  = 0x21,
+    HAL_UART_STATE_BUSY_RX  = 0x22
+} HAL_UART_StateTypeDef;
+
+typedef struct
+{
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+    uint32_t OneBitSampling;
+} UART_InitTypeDef;
+
+typedef struct
+{
+    uint32_t AdvFeatureInit;
+} UART_AdvFeatureInitTypeDef;
+
+typedef struct __UART_HandleTypeDef
+{
+    USART_TypeDef*              Instance;
+    UART_InitTypeDef            Init;
+    UART_AdvFeatureInitTypeDef  AdvancedInit;
+    uint8_t*                    pRxBuffPtr;
+    uint16_t                    RxXferSize;
+    DMA_HandleTypeDef*          hdmatx;
+    DMA_HandleTypeDef*          hdmarx;
+    HAL_LockTypeDef             Lock;
+    __IO HAL_UART_StateTypeDef  gState;
+    __IO HAL_UART_StateTypeDef  RxState;
+    __IO uint32_t               ErrorCode;
+} UART_HandleTypeDef;
+
+/* Constants -----------------------------------------------------------------*/
+#define UART_WORDLENGTH_7B          0x10000000U
+#define UART_WORDLENGTH_8B          0x00000000U
+#define UART_WORDLENGTH_9B          0x00001000U
+#define UART_STOPBITS_1             0x00000000U
+#define UART_STOPBITS_1_5           0x00003000U
+#define UART_STOPBITS_2             0x00002000U
+#define UART_PARITY_NONE            0x00000000U
+#define UART_PARITY_EVEN            0x00000400U
+#define UART_PARITY_ODD             0x00000600U
+#define UART_MODE_TX_RX             0x0000000CU
+#define UART_HWCONTROL_NONE         0x00000000U
+#define UART_OVERSAMPLING_16        0x00000000U
+#define UART_ONE_BIT_SAMPLE_DISABLE 0x00000000U
+#define UART_ADVFEATURE_NO_INIT     0x00000000U
+
+#define UART_CLEAR_PEF              (1UL << 0)
+#define UART_CLEAR_FEF              (1UL << 1)
+#define UART_CLEAR_NEF              (1UL << 2)
+#define UART_CLEAR_OREF             (1UL << 3)
+#define UART_CLEAR_IDLEF            (1UL << 4)
+#define UART_CLEAR_TCF              (1UL << 6)
+#define UART_CLEAR_RTOF             (1UL << 11)
+#define UART_CLEAR_CMF              (1UL << 17)
+
+#define DMA_REQUEST_0               0U
+#define DMA_REQUEST_2               2U
+#define DMA_REQUEST_4               4U
+#define DMA_PERIPH_TO_MEMORY        0x00000000U
+#define DMA_MEMORY_TO_PERIPH        0x00000010U
+#define DMA_MEMORY_TO_MEMORY        0x00004000U
+#define DMA_PINC_ENABLE             0x00000040U
+#define DMA_PINC_DISABLE            0x00000000U
+#define DMA_MINC_ENABLE             0x00000080U
+#define DMA_MINC_DISABLE            0x00000000U
+#define DMA_PDATAALIGN_BYTE         0x00000000U
+#define DMA_PDATAALIGN_WORD         0x00000200U
+#define DMA_MDATAALIGN_BYTE         0x00000000U
+#define DMA_MDATAALIGN_WORD         0x00000800U
+#define DMA_NORMAL                  0x00000000U
+#define DMA_CIRCULAR                DMA_CCR_CIRC
+#define DMA_PRIORITY_LOW            0x00000000U
+#define DMA_PRIORITY_HIGH           0x00002000U
+#define DMA_PRIORITY_VERY_HIGH      0x00003000U
+
+#define DMA_IT_TC                   DMA_CCR_TCIE
+#define DMA_IT_HT                   DMA_CCR_HTIE
+#define DMA_IT_TE                   DMA_CCR_TEIE
+#define DMA_FLAG_TC                 (1UL << 1)
+#define DMA_FLAG_HT                 (1UL << 2)
+
+/* Macros --------------------------------------------------------------------*/
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+    do { (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__); (__DMA_HANDLE__).Parent = (__HANDLE__); } while(0)
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__)           ((__HANDLE__)->Instance->CNDTR)
+#define __HAL_DMA_GET_TC_FLAG_INDEX(__HANDLE__)     DMA_FLAG_TC
+#define __HAL_DMA_GET_FLAG(__HANDLE__, __FLAG__)    ((__HANDLE__)->Instance->flags & (__FLAG__))
+#define __HAL_DMA_ENABLE_IT(__HANDLE__, __IT__)     ((__HANDLE__)->Instance->CCR |= (__IT__))
+#define __HAL_DMA_DISABLE_IT(__HANDLE__, __IT__)    ((__HANDLE__)->Instance->CCR &= ~(__IT__))
+#define __HAL_DMA_ENABLE(__HANDLE__)                ((__HANDLE__)->Instance->CCR |= DMA_CCR_EN)
+#define __HAL_DMA_DISABLE(__HANDLE__)               ((__HANDLE__)->Instance->CCR &= ~DMA_CCR_EN)
+
+#define __HAL_UART_ENABLE(__HANDLE__)               ((__HANDLE__)->Instance->CR1 |= USART_CR1_UE)
+#define __HAL_UART_DISABLE(__HANDLE__)              ((__HANDLE__)->Instance->CR1 &= ~USART_CR1_UE)
+
+#define __HAL_RCC_DMA1_CLK_ENABLE()                 do { } while(0)
+#define __HAL_RCC_DMA2_CLK_ENABLE()                 do { } while(0)
+#define __HAL_RCC_CRC_CLK_ENABLE()                  do { } while(0)
+
+/* Functions -----------------------------------------------------------------*/
+uint32_t HAL_GetTick(void);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef* hdma);
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef UART_SetConfig(UART_HandleTypeDef* huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32L4xx_HAL_H */
@@ -0,0 +1,34 @@
+#ifndef __USBD_CDC_IF_H
+#define __USBD_CDC_IF_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Host stand-in of the CDC interface
+ * Only the bulk streaming API used by bulk.c is defined. It is implemented by the host harness
+ * (bulkhost.c), which models the bulk IN endpoint and the host.
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Defines -------------------------------------------------------------------*/
+#define CDC_TX_QUEUE_SIZE   4   /* Number of queued IN transfers, as in Inc/usbd_cdc_if.h */
+
+/* Type definitions ----------------------------------------------------------*/
+typedef enum
+{
+    USBD_OK   = 0,
+    USBD_BUSY,
+    USBD_FAIL
+} USBD_StatusTypeDef;
+
+/* Exported functions --------------------------------------------------------*/
+uint8_t CDC_TransmitBulk_FS(uint8_t* Buf, uint16_t Len, uint8_t zlp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CDC_IF_H */
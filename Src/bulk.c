@@ -0,0 +1,133 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   bulk.c
+  * @brief  Bulk streaming
+  *         This file contains the sink of the RX engine that streams the
+  *         received data over the bulk IN endpoint of the vendor-specific
+  *         interface, in large transfers straight from the DMA buffer.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "bulk.h"
+#include "usbd_cdc_if.h"
+#include "stats.h"
+
+/* Private variables ---------------------------------------------------------*/
+/* Bulk IN transfer state (free-running byte counters) */
+static uint32_t bulk_queued;            /* Bytes queued for transmission */
+static uint32_t bulk_released;          /* Bytes released to the RX engine */
+static volatile uint32_t bulk_done;     /* Bytes sent, incremented from the USB interrupt */
+static uint8_t bulk_open;               /* Host read not terminated: the last transfer ended with a full packet */
+
+/**
+  * @brief  Initialize the bulk streaming state
+  * @param  None
+  * @retval None
+  */
+void Bulk_Init(void)
+{
+    bulk_queued = 0;
+    bulk_released = 0;
+    bulk_done = 0;
+    bulk_open = 0;
+}
+
+/** Bulk streaming
+ * The unreleased data is sent straight from the DMA buffer in transfers of up to USB_BULK_XFER_SIZE bytes.
+ * Like the CDC forwarding, the data is aggregated into full packets and a short packet is sent only when the
+ * DMA Timeout event flushes the data, or at the end of the buffer. The host reads the stream in large
+ * requests, which complete on a short packet (or zero-length packet) or when the request is full:
+ *  - a transfer of the continuous stream is not terminated, thus the host request is filled up with full
+ *    packets across several transfers and no bus time is spent on zero-length packets,
+ *  - the last transfer of flushed data is terminated, with a zero-length packet if it ends with a full
+ *    packet, thus the data is returned to the host application without waiting for further data,
+ *  - if the flushed data was already queued in unterminated transfers, a zero-length transfer follows.
+ * Up to CDC_TX_QUEUE_SIZE transfers are queued and chained from the USB interrupt, so the endpoint always
+ * has a packet ready when the host polls it. The data of a transfer is released when it is complete.
+*/
+void Bulk_Forward(UART_DMA_t* ch)
+{
+    DMA_Span_t span[2];
+    uint32_t done = bulk_done;
+    uint32_t skip, len, xfer;
+    uint8_t* ptr;
+    uint8_t n, i, last;
+
+    /* Release data of the completed transfers */
+    UART_DMA_Release(ch, done - bulk_released);
+    bulk_released = done;
+
+    /* Data in the queued transfers is skipped */
+    skip = bulk_queued - done;
+
+    n = UART_DMA_GetSpans(ch, span);
+    for(i = 0; i < n; ++i)
+    {
+        if(skip >= span[i].len)
+        {
+            skip -= span[i].len;
+            continue;
+        }
+        ptr = span[i].ptr + skip;
+        len = span[i].len - skip;
+        skip = 0;
+
+        while(len > 0)
+        {
+            xfer = (len > USB_BULK_XFER_SIZE) ? USB_BULK_XFER_SIZE : len;
+            last = (i == n - 1) && (xfer == len);
+
+            if(last && !ch->flush)
+            {
+                /* Send full packets only, the remainder is sent when filled up or on timeout */
+                xfer -= xfer % BULK_PACKET_SIZE;
+                if(xfer == 0)
+                {
+                    return;
+                }
+            }
+
+            if(CDC_TransmitBulk_FS(ptr, (uint16_t)xfer, last && ch->flush) != USBD_OK)
+            {
+                return;
+            }
+            bulk_queued += xfer;
+            bulk_open = !(last && ch->flush) && (xfer % BULK_PACKET_SIZE == 0);
+            ptr += xfer;
+            len -= xfer;
+        }
+    }
+
+    /* Everything is queued */
+    if(ch->flush)
+    {
+        /* Terminate the host read of the data queued before the flush, the buffer is the current ring position */
+        if(bulk_open)
+        {
+            if(CDC_TransmitBulk_FS(&ch->rx.buf[ch->rx.wr & ch->rx.mask], 0, 1) != USBD_OK)
+            {
+                return;
+            }
+            bulk_open = 0;
+        }
+        STATS_USB_SUBMIT(&ch->latency);
+    }
+    ch->flush = 0;
+}
+
+/**
+  * @brief  Bulk IN transfer complete, called from the USB interrupt
+  * @param  len: number of bytes sent
+  * @retval None
+  */
+void Bulk_TxCplt(uint32_t len)
+{
+    bulk_done += len;
+    UART_DMA_Schedule();
+}
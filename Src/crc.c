@@ -0,0 +1,171 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   crc.c
+  * @brief  Incremental CRC
+  *         This file contains the CRC-16/X.25 and CRC-32 computation used to
+  *         verify the received frames. The CRC peripheral of the STM32L4 is
+  *         used on the target; the host build (simulation) uses slice-by-4
+  *         lookup tables with the same results.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32l4xx_hal.h"
+#include "crc.h"
+
+/* Defines -------------------------------------------------------------------*/
+/* Polynomials: normal form (CRC peripheral) and reflected form (tables) */
+#define CRC_16_POLY         0x1021U
+#define CRC_16_POLY_REF     0x8408U
+#define CRC_32_POLY         0x04C11DB7U
+#define CRC_32_POLY_REF     0xEDB88320U
+
+/* Initial value and final XOR */
+#define CRC_MASK(__WIDTH__) (0xFFFFFFFFU >> (32 - (__WIDTH__)))
+
+/* Private variables ---------------------------------------------------------*/
+#if !defined(CRC)
+static uint32_t crc_table[2][4][256];   /* Slice-by-4 tables of CRC_16 and CRC_32 */
+#endif
+
+/**
+  * @brief  Prepare the CRC unit: enable the peripheral clock (target) or build the tables (host)
+  * @param  None
+  * @retval None
+  */
+void Crc_Init(void)
+{
+#if defined(CRC)
+    __HAL_RCC_CRC_CLK_ENABLE();
+#else
+    static const uint32_t poly[2] = { CRC_16_POLY_REF, CRC_32_POLY_REF };
+    uint32_t i, k, t, v;
+
+    for(t = 0; t < 2; ++t)
+    {
+        for(i = 0; i < 256; ++i)
+        {
+            v = i;
+            for(k = 0; k < 8; ++k)
+            {
+                v = (v >> 1) ^ ((v & 1) ? poly[t] : 0);
+            }
+            crc_table[t][0][i] = v;
+        }
+        for(i = 0; i < 256; ++i)
+        {
+            for(k = 1; k < 4; ++k)
+            {
+                v = crc_table[t][k - 1][i];
+                crc_table[t][k][i] = (v >> 8) ^ crc_table[t][0][v & 0xFF];
+            }
+        }
+    }
+#endif
+}
+
+/**
+  * @brief  Start a new computation
+  * @param  c: running CRC
+  * @param  width: CRC_16 or CRC_32
+  * @retval None
+  */
+void Crc_Start(Crc_t* c, uint8_t width)
+{
+    c->width = width;
+    c->value = CRC_MASK(width);
+}
+
+/** Incremental update
+ * Target: the CRC peripheral is loaded with the running value (INIT register and RESET), thus the
+ * computation can be continued after any other use of the peripheral. The input is reversed by byte
+ * in the peripheral (reflected CRC); aligned words are written at once in byte-swapped order, so that
+ * the first byte in memory is processed first. The output is not reversed by the peripheral, the
+ * register is converted to the reflected form with RBIT.
+ * Host: slice-by-4, four table lookups per word and one per remaining byte.
+*/
+
+/**
+  * @brief  Add data to the CRC
+  * @param  c: running CRC
+  * @param  data: data
+  * @param  len: number of bytes
+  * @retval None
+  */
+void Crc_Update(Crc_t* c, const uint8_t* data, uint32_t len)
+{
+#if defined(CRC)
+    const uint8_t shift = 32 - c->width;
+#else
+    const uint32_t (*table)[256] = crc_table[(c->width == CRC_16) ? 0 : 1];
+    uint32_t v = c->value;
+#endif
+
+    if(len == 0)
+    {
+        return;
+    }
+
+#if defined(CRC)
+    CRC->POL = (c->width == CRC_16) ? CRC_16_POLY : CRC_32_POLY;
+    CRC->INIT = __RBIT(c->value) >> shift;
+    CRC->CR = ((c->width == CRC_16) ? CRC_CR_POLYSIZE_0 : 0) | CRC_CR_REV_IN_0 | CRC_CR_RESET;
+
+    while(((uint32_t)(uintptr_t)data & 3) && len)
+    {
+        *(__IO uint8_t*)&CRC->DR = *data++;
+        --len;
+    }
+    while(len >= 4)
+    {
+        CRC->DR = __REV(*(const uint32_t*)data);
+        data += 4;
+        len -= 4;
+    }
+    while(len--)
+    {
+        *(__IO uint8_t*)&CRC->DR = *data++;
+    }
+
+    c->value = __RBIT(CRC->DR << shift);
+#else
+    while(len >= 4)
+    {
+        v ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        v = table[3][v & 0xFF] ^ table[2][(v >> 8) & 0xFF] ^ table[1][(v >> 16) & 0xFF] ^ table[0][v >> 24];
+        data += 4;
+        len -= 4;
+    }
+    while(len--)
+    {
+        v = (v >> 8) ^ table[0][(v ^ *data++) & 0xFF];
+    }
+
+    c->value = v;
+#endif
+}
+
+/**
+  * @brief  Get the CRC of the data (check sequence to be sent LSB first)
+  * @param  c: running CRC
+  * @retval CRC
+  */
+uint32_t Crc_Final(const Crc_t* c)
+{
+    return c->value ^ CRC_MASK(c->width);
+}
+
+/**
+  * @brief  Check the CRC of data followed by its check sequence
+  * @param  c: running CRC over the data and the check sequence
+  * @retval 1 if the data is intact, 0 otherwise
+  */
+uint8_t Crc_IsGood(const Crc_t* c)
+{
+    return c->value == ((c->width == CRC_16) ? CRC_16_GOOD : CRC_32_GOOD);
+}
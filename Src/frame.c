@@ -0,0 +1,297 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   frame.c
+  * @brief  Streaming frame decoder
+  *         This file contains the framing stage between the UART receiver and
+  *         the USB: COBS, SLIP and HDLC-like byte stuffed frames are decoded
+  *         incrementally as the data arrives, in constant memory, so that
+  *         every frame can be sent as one USB transfer.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "frame.h"
+
+/* Defines -------------------------------------------------------------------*/
+/* Decoder states */
+#define FRAME_STATE_DATA        0   /* Receiving frame data */
+#define FRAME_STATE_ESCAPE      1   /* Escape character received (SLIP, HDLC) */
+#define FRAME_STATE_DISCARD     2   /* Frame dropped, waiting for the delimiter */
+#define FRAME_STATE_COMPLETE    3   /* Frame returned to the caller */
+
+/* SLIP special characters (RFC 1055) */
+#define SLIP_END                0xC0
+#define SLIP_ESC                0xDB
+#define SLIP_ESC_END            0xDC
+#define SLIP_ESC_ESC            0xDD
+
+/* HDLC-like framing special characters (RFC 1662, asynchronous byte stuffing) */
+#define HDLC_FLAG               0x7E
+#define HDLC_ESC                0x7D
+#define HDLC_XOR                0x20
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t Frame_DecodeCobs(Frame_t* f, const uint8_t* data, uint32_t len, uint32_t* used);
+static uint8_t Frame_DecodeEscaped(Frame_t* f, const uint8_t* data, uint32_t len, uint32_t* used);
+static void Frame_Reset(Frame_t* f, uint8_t state);
+
+/**
+  * @brief  Initialize the decoder
+  * @param  f: decoder
+  * @param  codec: FRAME_COBS, FRAME_SLIP or FRAME_HDLC
+  * @param  crc: check sequence at the end of the frames: CRC_16, CRC_32 or 0 (none)
+  * @param  buf: buffer of the decoded frame
+  * @param  size: buffer size in bytes, longer frames are dropped (check sequence included)
+  * @retval None
+  */
+void Frame_Init(Frame_t* f, uint8_t codec, uint8_t crc, uint8_t* buf, uint16_t size)
+{
+    f->buf = buf;
+    f->size = size;
+    f->codec = codec;
+    f->fcs = crc / 8;
+    if(f->fcs)
+    {
+        Crc_Init();
+        Crc_Start(&f->crc, crc);
+    }
+    Frame_Reset(f, FRAME_STATE_DATA);
+}
+
+/** Incremental decoding
+ * The input is consumed until the end of a frame or the end of the input, thus the received data can be
+ * passed in arbitrary pieces (e.g. the spans of the DMA buffer) without reassembly. The decoder state is
+ * a few bytes, the only buffer is the decoded frame.
+ * Remarks:
+ *  - Decoding stops after the delimiter of a frame, the rest of the input is left for the next call.
+ *    The returned frame is valid until the next call.
+ *  - Empty frames (e.g. consecutive delimiters, used as frame separators by HDLC and SLIP) are skipped.
+ *  - A frame with an invalid code or escape sequence, an aborted frame (escape followed by the delimiter)
+ *    and a frame longer than the buffer is reported once with FRAME_ERROR, the rest of it is dropped
+ *    till the next delimiter.
+ *  - With CRC, the bytes decoded by the call are added to the CRC of the frame before returning, while they
+ *    are still in the cache, thus the frame is verified without a second pass when its delimiter arrives.
+ *    The check sequence (sent LSB first) is removed from the returned frame; a frame with an invalid check
+ *    sequence is returned with FRAME_BAD_FCS, so that the caller can drop or flag it.
+*/
+
+/**
+  * @brief  Decode received data
+  * @param  f: decoder
+  * @param  data: received (encoded) data
+  * @param  len: number of bytes
+  * @param  used: number of bytes consumed
+  * @retval FRAME_MORE, FRAME_DONE, FRAME_ERROR or FRAME_BAD_FCS
+  */
+uint8_t Frame_Decode(Frame_t* f, const uint8_t* data, uint32_t len, uint32_t* used)
+{
+    uint8_t result;
+
+    /* Previous frame has been taken by the caller */
+    if(f->state == FRAME_STATE_COMPLETE)
+    {
+        Frame_Reset(f, FRAME_STATE_DATA);
+    }
+
+    if(f->codec == FRAME_COBS)
+    {
+        result = Frame_DecodeCobs(f, data, len, used);
+    }
+    else
+    {
+        result = Frame_DecodeEscaped(f, data, len, used);
+    }
+
+    if(f->fcs == 0 || result == FRAME_ERROR)
+    {
+        return result;
+    }
+
+    /* Newly decoded bytes */
+    Crc_Update(&f->crc, &f->buf[f->checked], f->len - f->checked);
+    f->checked = f->len;
+
+    if(result == FRAME_DONE)
+    {
+        if(f->len <= f->fcs)
+        {
+            Frame_Reset(f, FRAME_STATE_DATA);
+            return FRAME_ERROR;
+        }
+        f->len -= f->fcs;
+        if(!Crc_IsGood(&f->crc))
+        {
+            return FRAME_BAD_FCS;
+        }
+    }
+    return result;
+}
+
+/* COBS: every block starts with a code byte n, n - 1 data bytes follow and the block ends with an implied zero,
+ * except for n = 0xFF and the last block of the frame. The frame is terminated by 0x00. */
+static uint8_t Frame_DecodeCobs(Frame_t* f, const uint8_t* data, uint32_t len, uint32_t* used)
+{
+    uint32_t i = 0;
+    uint8_t result = FRAME_MORE;
+    uint8_t b;
+
+    while(i < len)
+    {
+        b = data[i++];
+
+        if(b == 0x00)
+        {
+            if(f->state == FRAME_STATE_DISCARD)
+            {
+                Frame_Reset(f, FRAME_STATE_DATA);
+                continue;
+            }
+            /* Frame ends inside a block */
+            if(f->left != 0)
+            {
+                Frame_Reset(f, FRAME_STATE_DATA);
+                result = FRAME_ERROR;
+                break;
+            }
+            if(f->len == 0)
+            {
+                Frame_Reset(f, FRAME_STATE_DATA);
+                continue;
+            }
+            f->state = FRAME_STATE_COMPLETE;
+            result = FRAME_DONE;
+            break;
+        }
+
+        if(f->state == FRAME_STATE_DISCARD)
+        {
+            continue;
+        }
+
+        if(f->left == 0)
+        {
+            /* Code byte: the previous block ends with a zero */
+            if(f->code != 0 && f->code != 0xFF)
+            {
+                if(f->len == f->size)
+                {
+                    Frame_Reset(f, FRAME_STATE_DISCARD);
+                    result = FRAME_ERROR;
+                    break;
+                }
+                f->buf[f->len++] = 0x00;
+            }
+            f->code = b;
+            f->left = b - 1;
+            continue;
+        }
+
+        if(f->len == f->size)
+        {
+            Frame_Reset(f, FRAME_STATE_DISCARD);
+            result = FRAME_ERROR;
+            break;
+        }
+        f->buf[f->len++] = b;
+        --f->left;
+    }
+
+    *used = i;
+    return result;
+}
+
+/* SLIP and HDLC-like framing: the delimiter and the escape character are sent as escape sequences */
+static uint8_t Frame_DecodeEscaped(Frame_t* f, const uint8_t* data, uint32_t len, uint32_t* used)
+{
+    const uint8_t delim = (f->codec == FRAME_SLIP) ? SLIP_END : HDLC_FLAG;
+    const uint8_t esc = (f->codec == FRAME_SLIP) ? SLIP_ESC : HDLC_ESC;
+    uint32_t i = 0;
+    uint8_t result = FRAME_MORE;
+    uint8_t b;
+
+    while(i < len)
+    {
+        b = data[i++];
+
+        if(b == delim)
+        {
+            /* Abort sequence */
+            if(f->state == FRAME_STATE_ESCAPE)
+            {
+                Frame_Reset(f, FRAME_STATE_DATA);
+                result = FRAME_ERROR;
+                break;
+            }
+            if(f->state == FRAME_STATE_DISCARD || f->len == 0)
+            {
+                Frame_Reset(f, FRAME_STATE_DATA);
+                continue;
+            }
+            f->state = FRAME_STATE_COMPLETE;
+            result = FRAME_DONE;
+            break;
+        }
+
+        if(f->state == FRAME_STATE_DISCARD)
+        {
+            continue;
+        }
+
+        if(f->state == FRAME_STATE_ESCAPE)
+        {
+            f->state = FRAME_STATE_DATA;
+            if(f->codec == FRAME_HDLC)
+            {
+                b ^= HDLC_XOR;
+            }
+            else if(b == SLIP_ESC_END)
+            {
+                b = SLIP_END;
+            }
+            else if(b == SLIP_ESC_ESC)
+            {
+                b = SLIP_ESC;
+            }
+            else
+            {
+                Frame_Reset(f, FRAME_STATE_DISCARD);
+                result = FRAME_ERROR;
+                break;
+            }
+        }
+        else if(b == esc)
+        {
+            f->state = FRAME_STATE_ESCAPE;
+            continue;
+        }
+
+        if(f->len == f->size)
+        {
+            Frame_Reset(f, FRAME_STATE_DISCARD);
+            result = FRAME_ERROR;
+            break;
+        }
+        f->buf[f->len++] = b;
+    }
+
+    *used = i;
+    return result;
+}
+
+static void Frame_Reset(Frame_t* f, uint8_t state)
+{
+    if(f->fcs)
+    {
+        Crc_Start(&f->crc, f->crc.width);
+    }
+    f->checked = 0;
+    f->len = 0;
+    f->code = 0;
+    f->left = 0;
+    f->state = state;
+}
@@ -14,45 +14,126 @@
 **/
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "stm32l4xx.h"
 #include "main.h"
 #include "usb_device.h"
 #include "usbd_cdc_if.h"
+#include "uart_dma.h"
+#include "frame.h"
+#include "scan.h"
+#include "bulk.h"
+#include "stats.h"
 
-/* HAL handle structures -----------------------------------------------------*/
-UART_HandleTypeDef huart2;
-DMA_HandleTypeDef hdma_usart2_rx;
+/* RX engines of the bridged serial ports, one per CDC function: USART2 (ST-Link VCP) first */
+UART_DMA_t uart_dma[USB_CDC_PORTS];
+uint8_t dma_rx_buf[USB_CDC_PORTS][DMA_BUF_SIZE];        /* Circular buffers for DMA */
+uint8_t uart_tx_buf[USB_CDC_PORTS][UART_TX_BUF_SIZE];   /* TX rings for DMA */
+static const UART_DMA_PortId_t uart_port[USB_CDC_PORTS] =
+{
+    UART_DMA_USART2,
+#if (USB_CDC_PORTS > 1)
+    USB_CDC_PORT2_UART,
+#endif
+};
 
-/* DMA Timeout event structure
- * Note: prevCNDTR initial value must be set to maximum size of DMA buffer!
-*/
-DMA_Event_t dma_uart_rx = {0,0,DMA_BUF_SIZE};
+/* CDC function (port) of an RX engine */
+#define USB_PORT(ch)        ((uint8_t)((ch) - uart_dma))
+
+#if (UART_DMA_STAMP == 1)
+/* Timestamped records: one USB IN transfer per record (free-running record counters) */
+#define STAMP_HEADER_SIZE   6           /* Record header: data length (16-bit) and DWT timestamp (32-bit), little-endian */
+#define STAMP_BUF_COUNT     CDC_TX_QUEUE_SIZE   /* Record buffers: one per queued transfer */
+static uint8_t stamp_buf[STAMP_BUF_COUNT][STAMP_RECORD_SIZE];
+static uint32_t stamp_queued;           /* Records queued for transmission */
+static volatile uint32_t stamp_sent;    /* Records sent, incremented from the USB interrupt */
+#elif (FRAME_CODEC == FRAME_NONE)
+/* USB IN transfer state per port (free-running byte counters) */
+static uint32_t usb_tx_released[USB_CDC_PORTS];         /* Bytes released to the RX engine */
+static volatile uint32_t usb_tx_done[USB_CDC_PORTS];    /* Bytes sent, incremented from the USB interrupt */
+#if (USB_LINE_ENABLE == 1)
+/* Line forwarding per port: scanner and the spans of the line not queued yet */
+static Scan_t usb_scan[USB_CDC_PORTS];
+static DMA_Span_t usb_line[USB_CDC_PORTS][2];
+static uint8_t usb_line_n[USB_CDC_PORTS];
+#define USB_FORWARD         USB_ForwardLines
+#else
+static uint32_t usb_tx_queued[USB_CDC_PORTS];           /* Bytes queued for transmission */
+#define USB_FORWARD         USB_Forward
+#endif
+#else
+/* Framing stage: one USB IN transfer per decoded frame (free-running frame counters) */
+#define FRAME_BUF_COUNT     2           /* Frame buffers: a frame is decoded while the previous one is sent */
+static Frame_t frame;
+static uint8_t frame_buf[FRAME_BUF_COUNT][FRAME_MAX_SIZE];
+static uint8_t frame_ready;             /* Decoded frame waiting for a free transfer slot */
+static uint32_t frame_queued;           /* Frames queued for transmission */
+static volatile uint32_t frame_sent;    /* Frames sent, incremented from the USB interrupt */
+#endif
 
-uint8_t dma_rx_buf[DMA_BUF_SIZE];       /* Circular buffer for DMA */
-uint8_t data[DMA_BUF_SIZE] = {'\0'};    /* Data buffer that contains newly received data */
+/* USB OUT flow control per port */
+static volatile uint8_t usb_rx_hold[USB_CDC_PORTS];     /* OUT endpoint not re-armed because of full TX ring */
+
+/* Last vendor command received over the CDC control interface */
+static uint8_t usb_cmd;
+
+/* Private function prototypes -----------------------------------------------*/
+#if (UART_DMA_STAMP == 1)
+static void USB_ForwardStamped(UART_DMA_t* ch);
+#elif (FRAME_CODEC == FRAME_NONE) && (USB_LINE_ENABLE == 1)
+static void USB_ForwardLines(UART_DMA_t* ch);
+#elif (FRAME_CODEC == FRAME_NONE)
+static void USB_Forward(UART_DMA_t* ch);
+#else
+static void USB_ForwardFrames(UART_DMA_t* ch);
+#endif
+static void UART_TxReady(UART_DMA_t* ch);
 
 /** Main function *************************************************************/
 int main(void)
 {
+    uint8_t port;
+    
     HAL_Init();
     SystemClock_Config();
 
     GPIO_Init();
+    Stats_Init();
+    
+    /* UARTs are initialized before the USB, the host may set the line coding during enumeration */
+#if (FRAME_CODEC != FRAME_NONE) && (UART_DMA_STAMP == 0)
+    Frame_Init(&frame, FRAME_CODEC, FRAME_CRC, frame_buf[0], FRAME_MAX_SIZE);
+#endif
+#if (USB_BULK_ENABLE == 1)
+    Bulk_Init();
+#endif
+    for(port = 0; port < USB_CDC_PORTS; ++port)
+    {
+#if (USB_LINE_ENABLE == 1)
+        Scan_Init(&usb_scan[port], DMA_MATCH_CHAR);
+#endif
+#if (USB_BULK_ENABLE == 1)
+        /* USART2 is streamed over the bulk interface, its CDC function carries the OUT direction and line coding */
+        UART_DMA_Init(&uart_dma[port], uart_port[port], UART_BAUDRATE, dma_rx_buf[port], DMA_BUF_SIZE, (port == 0) ? Bulk_Forward : USB_FORWARD);
+#elif (UART_DMA_STAMP == 1)
+        UART_DMA_Init(&uart_dma[port], uart_port[port], UART_BAUDRATE, dma_rx_buf[port], DMA_BUF_SIZE, USB_ForwardStamped);
+#elif (FRAME_CODEC == FRAME_NONE)
+        UART_DMA_Init(&uart_dma[port], uart_port[port], UART_BAUDRATE, dma_rx_buf[port], DMA_BUF_SIZE, USB_FORWARD);
+#else
+        UART_DMA_Init(&uart_dma[port], uart_port[port], UART_BAUDRATE, dma_rx_buf[port], DMA_BUF_SIZE, USB_ForwardFrames);
+#endif
+        UART_DMA_InitTx(&uart_dma[port], uart_tx_buf[port], UART_TX_BUF_SIZE, UART_TxReady);
+    }
+    
     USB_DEVICE_Init();
     HAL_Delay(1000);
-
-    UART_Init();
-    DMA_Init();
     
     /* Start DMA */
-    if(HAL_UART_Receive_DMA(&huart2, (uint8_t*)dma_rx_buf, DMA_BUF_SIZE) != HAL_OK)
-    {        
-        Error_Handler();
+    for(port = 0; port < USB_CDC_PORTS; ++port)
+    {
+        UART_DMA_Start(&uart_dma[port]);
     }
     
-    /* Disable Half Transfer Interrupt */
-    __HAL_DMA_DISABLE_IT(huart2.hdmarx, DMA_IT_HT);
-    
     while(1)
     {
         LED_G_TG();
@@ -60,117 +141,357 @@ int main(void)
     }
 }
 
-/** DMA Rx Complete AND DMA Rx Timeout function
- * Timeout event: generated after UART IDLE IT + DMA Timeout value
- * Scenarios:
- *  - Timeout event when previous event was DMA Rx Complete --> new data is from buffer beginning till (MAX-currentCNDTR)
- *  - Timeout event when previous event was Timeout event   --> buffer contains old data, new data is in the "middle": from (MAX-previousCNDTR) till (MAX-currentCNDTR)
- *  - DMA Rx Complete event when previous event was DMA Rx Complete --> entire buffer holds new data
- *  - DMA Rx Complete event when previous event was Timeout event   --> buffer entirely filled but contains old data, new data is from (MAX-previousCNDTR) till MAX
- * Remarks:
- *  - If there is no following data after DMA Rx Complete, the generated IDLE Timeout has to be ignored!
- *  - When buffer overflow occurs, the following has to be performed in order not to lose data:
- *      (1): DMA Rx Complete event occurs, process first part of new data till buffer MAX.
- *      (2): In this case, the currentCNDTR is already decreased because of overflow.
- *              However, previousCNDTR has to be set to MAX in order to signal for upcoming Timeout event that new data has to be processed from buffer beginning.
- *      (3): When many overflows occur, simply process DMA Rx Complete events (process entire DMA buffer) until Timeout event occurs.
- *      (4): When there is no more overflow, Timeout event occurs, process last part of data from buffer beginning till currentCNDTR.
+#if (UART_DMA_STAMP == 1)
+/* Send every received chunk over USB as a record, with its arrival time
+ * Record: STAMP_HEADER_SIZE bytes header (data length, DWT timestamp of the end of the last character of the
+ * chunk, both little-endian), followed by the data. The host parses the stream record by record; the stamps
+ * are CPU cycles (SystemCoreClock), relative and wrapping around at 2^32.
+ * The chunk is copied into a record buffer and released, every record is sent as one USB transfer. The record
+ * buffers are used in turn like the frame buffers, one per queued transfer (see CDC_TxCpltCallback).
+ * A chunk longer than a record is split into several records with the same stamp.
 */
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+static void USB_ForwardStamped(UART_DMA_t* ch)
 {
-    uint16_t i, pos, start, length;
-    uint16_t currCNDTR = __HAL_DMA_GET_COUNTER(huart->hdmarx);
+    DMA_Span_t span[2];
+    RxChunk_t chunk;
+    uint8_t* rec;
+    uint32_t len;
+    uint16_t total;
+    uint8_t n, i;
+
+    while(stamp_queued - stamp_sent < STAMP_BUF_COUNT)
+    {
+        n = UART_DMA_GetStamped(ch, span, &chunk);
+        if(n == 0)
+        {
+            break;
+        }
+
+        rec = stamp_buf[stamp_queued % STAMP_BUF_COUNT];
+        total = STAMP_HEADER_SIZE;
+        for(i = 0; i < n && total < STAMP_RECORD_SIZE; ++i)
+        {
+            len = STAMP_RECORD_SIZE - total;
+            len = (span[i].len < len) ? span[i].len : len;
+            memcpy(&rec[total], span[i].ptr, len);
+            total += len;
+        }
+        rec[0] = (uint8_t)(total - STAMP_HEADER_SIZE);
+        rec[1] = (uint8_t)((total - STAMP_HEADER_SIZE) >> 8);
+        rec[2] = (uint8_t)chunk.stamp;
+        rec[3] = (uint8_t)(chunk.stamp >> 8);
+        rec[4] = (uint8_t)(chunk.stamp >> 16);
+        rec[5] = (uint8_t)(chunk.stamp >> 24);
+
+        if(CDC_Transmit_FS(USB_PORT(ch), rec, total) != USBD_OK)
+        {
+            return;
+        }
+        UART_DMA_Release(ch, total - STAMP_HEADER_SIZE);
+        ++stamp_queued;
+    }
+
+    /* Everything is queued */
+    if(ch->flush && RING_COUNT(&ch->rx) == 0)
+    {
+        STATS_USB_SUBMIT(&ch->latency);
+        ch->flush = 0;
+    }
+}
+#elif (FRAME_CODEC == FRAME_NONE) && (USB_LINE_ENABLE == 1)
+/* Send every received line over USB as one transfer, straight from the DMA buffer
+ * The scanner splits the unreleased data into lines terminated by DMA_MATCH_CHAR (the terminator is included),
+ * every line is queued as a transfer of its own, thus the host reads whole lines. A line wrapping around the
+ * buffer end is queued as two transfers. A line that does not fit into the DMA buffer is sent in pieces of the
+ * buffer size, and the DMA Timeout event sends the incomplete line at the end of transmission.
+ * The data of a line is released when the USB signals completion (see CDC_TxCpltCallback). A line that
+ * cannot be queued yet is kept with its spans not queued, and the rest of it is queued first on the next call.
+*/
+static void USB_ForwardLines(UART_DMA_t* ch)
+{
+    uint8_t port = USB_PORT(ch);
+    uint32_t done = usb_tx_done[port];
+    DMA_Span_t* line = usb_line[port];
     
-    /* Ignore IDLE Timeout when the received characters exactly filled up the DMA buffer and DMA Rx Complete IT is generated, but there is no new character during timeout */
-    if(dma_uart_rx.flag && currCNDTR == DMA_BUF_SIZE)
-    { 
-        dma_uart_rx.flag = 0;
-        return;
+    /* Release data of the completed transfers */
+    UART_DMA_Release(ch, done - usb_tx_released[port]);
+    usb_tx_released[port] = done;
+    
+    while(1)
+    {
+        /* Next complete line, or the incomplete one at the end of transmission */
+        if(usb_line_n[port] == 0)
+        {
+            usb_line_n[port] = Scan_Next(&usb_scan[port], &ch->rx, line);
+            if(usb_line_n[port] == 0 && ch->flush)
+            {
+                usb_line_n[port] = Scan_Flush(&usb_scan[port], &ch->rx, line);
+            }
+            if(usb_line_n[port] == 0)
+            {
+                break;
+            }
+        }
+        
+        /* Queue the spans of the line in order */
+        while(usb_line_n[port])
+        {
+            if(CDC_Transmit_FS(port, line[0].ptr, (uint16_t)line[0].len) != USBD_OK)
+            {
+                return;
+            }
+            line[0] = line[1];
+            --usb_line_n[port];
+        }
+    }
+    
+    /* Everything is queued */
+    if(ch->flush)
+    {
+        STATS_USB_SUBMIT(&ch->latency);
     }
+    ch->flush = 0;
+}
+#elif (FRAME_CODEC == FRAME_NONE)
+/* Send unreleased data over USB straight from the DMA buffer
+ * The received data is aggregated into full packets of CDC_DATA_FS_MAX_PACKET_SIZE bytes in order to
+ * maximise the USB throughput. Data is queued for transmission when:
+ *  - at least one full packet is available (all full packets are sent in a single transfer),
+ *  - the DMA Timeout event signals the end of transmission (flush, short packet is allowed),
+ *  - the unreleased data wraps around the buffer end (the first span is sent as is).
+ * Up to CDC_TX_QUEUE_SIZE transfers are queued, the CDC interface chains them from the USB interrupt.
+ * The data of a transfer is released when the USB signals completion (see CDC_TxCpltCallback), which also
+ * triggers the worker to queue new data. Data that cannot be queued yet stays in the DMA buffer, thus
+ * nothing is dropped while the endpoint is busy.
+ * Every port is forwarded to its own CDC function with its own transfer state.
+*/
+static void USB_Forward(UART_DMA_t* ch)
+{
+    DMA_Span_t span[2];
+    uint8_t port = USB_PORT(ch);
+    uint32_t done = usb_tx_done[port];
+    uint32_t skip, len;
+    uint8_t* ptr;
+    uint8_t n, i;
     
-    /* Determine start position in DMA buffer based on previous CNDTR value */
-    start = (dma_uart_rx.prevCNDTR < DMA_BUF_SIZE) ? (DMA_BUF_SIZE - dma_uart_rx.prevCNDTR) : 0;
+    /* Release data of the completed transfers */
+    UART_DMA_Release(ch, done - usb_tx_released[port]);
+    usb_tx_released[port] = done;
     
-    if(dma_uart_rx.flag)    /* Timeout event */
+    /* Data in the queued transfers is skipped */
+    skip = usb_tx_queued[port] - done;
+    
+    n = UART_DMA_GetSpans(ch, span);
+    for(i = 0; i < n; ++i)
     {
-        /* Determine new data length based on previous DMA_CNDTR value:
-         *  If previous CNDTR is less than DMA buffer size: there is old data in DMA buffer (from previous timeout) that has to be ignored.
-         *  If CNDTR == DMA buffer size: entire buffer content is new and has to be processed.
-        */
-        length = (dma_uart_rx.prevCNDTR < DMA_BUF_SIZE) ? (dma_uart_rx.prevCNDTR - currCNDTR) : (DMA_BUF_SIZE - currCNDTR);
-        dma_uart_rx.prevCNDTR = currCNDTR;
-        dma_uart_rx.flag = 0;
+        if(skip >= span[i].len)
+        {
+            skip -= span[i].len;
+            continue;
+        }
+        ptr = span[i].ptr + skip;
+        len = span[i].len - skip;
+        skip = 0;
+        
+        if(i == n - 1 && !ch->flush)
+        {
+            /* Send full packets only, the remainder is sent when filled up or on timeout */
+            len -= len % CDC_DATA_FS_MAX_PACKET_SIZE;
+            if(len == 0)
+            {
+                return;
+            }
+        }
+        
+        if(CDC_Transmit_FS(port, ptr, (uint16_t)len) != USBD_OK)
+        {
+            return;
+        }
+        usb_tx_queued[port] += len;
     }
-    else                /* DMA Rx Complete event */
+    
+    /* Everything is queued */
+    if(ch->flush)
     {
-        length = DMA_BUF_SIZE - start;
-        dma_uart_rx.prevCNDTR = DMA_BUF_SIZE;
+        STATS_USB_SUBMIT(&ch->latency);
     }
+    ch->flush = 0;
+}
+#else
+/* Decode frames from the DMA buffer and send every frame as one USB transfer
+ * The received data is released as soon as it is decoded (Frame_Decode() stops at the end of each frame).
+ * The frame buffers are used in turn: a complete frame is queued for transmission and the next frame is
+ * decoded into the next buffer, which is free when its previous frame has been sent (see CDC_TxCpltCallback).
+ * If every buffer is in flight, the data stays in the DMA buffer until a transfer is complete.
+ * The DMA Timeout event does not cut frames, an incomplete frame waits for its delimiter.
+ * With FRAME_CRC, frames with invalid check sequence are dropped (or flagged) before they reach the USB.
+*/
+static void USB_ForwardFrames(UART_DMA_t* ch)
+{
+    DMA_Span_t span[2];
+    uint32_t used;
+    uint8_t result;
     
-    /* Copy and Process new data */
-    for(i=0,pos=start; i<length; ++i,++pos)
+    while(1)
     {
-        data[i] = dma_rx_buf[pos];
+        /* Queue the decoded frame */
+        if(frame_ready)
+        {
+            if(CDC_Transmit_FS(USB_PORT(ch), frame.buf, frame.len) != USBD_OK)
+            {
+                return;
+            }
+            STATS_USB_SUBMIT(&ch->latency);
+            frame_ready = 0;
+            ++frame_queued;
+        }
+        
+        /* Every frame buffer is in flight */
+        if(frame_queued - frame_sent >= FRAME_BUF_COUNT)
+        {
+            return;
+        }
+        frame.buf = frame_buf[frame_queued % FRAME_BUF_COUNT];
+        
+        if(UART_DMA_GetSpans(ch, span) == 0)
+        {
+            break;
+        }
+        result = Frame_Decode(&frame, span[0].ptr, span[0].len, &used);
+        UART_DMA_Release(ch, used);
+        
+        if(result == FRAME_BAD_FCS)
+        {
+            STATS_INC(crc_errors);
+#if (FRAME_CRC_DROP == 1)
+            continue;
+#endif
+        }
+        
+        if(result == FRAME_DONE || result == FRAME_BAD_FCS)
+        {
+#if (FRAME_CRC != 0) && (FRAME_CRC_DROP == 0)
+            /* Frame status: the check sequence is replaced by a status byte */
+            frame.buf[frame.len++] = (result == FRAME_BAD_FCS) ? 0x01 : 0x00;
+#endif
+            STATS_INC(frames);
+            frame_ready = 1;
+        }
+        else if(result == FRAME_ERROR)
+        {
+            STATS_INC(frame_errors);
+        }
     }
+    ch->flush = 0;
+}
+#endif
+
+/* USB IN transfer complete: release the sent data (or frame buffer) and queue new data from the RX worker */
+void CDC_TxCpltCallback(uint8_t port, uint8_t* Buf, uint32_t Len)
+{
+#if (UART_DMA_STAMP == 1)
+    ++stamp_sent;
+#elif (FRAME_CODEC == FRAME_NONE)
+    usb_tx_done[port] += Len;
+#else
+    ++frame_sent;
+#endif
+    UART_DMA_Schedule();
+}
+
+/* Bulk IN transfer complete: release the sent data and queue new data from the RX worker */
+void CDC_BulkTxCpltCallback(uint8_t* Buf, uint32_t Len)
+{
+    Bulk_TxCplt(Len);
+}
+
+/* USB OUT packet received: send it over UART
+ * The packet is copied into the TX ring of the UART. The OUT endpoint is re-armed only if the ring
+ * can hold another full packet, otherwise the host is NAKed until the DMA frees enough space
+ * (see UART_TxReady), thus the host is throttled to the UART baud rate and no data is lost.
+ * Both callbacks run from interrupts of the same priority.
+*/
+uint8_t CDC_RxCallback(uint8_t port, uint8_t* Buf, uint32_t Len)
+{
+    UART_DMA_Write(&uart_dma[port], Buf, (uint16_t)Len);
     
-    /* Send received data over USB */
-    CDC_Transmit_FS(data, length);
+    if(UART_DMA_TxFree(&uart_dma[port]) >= CDC_DATA_FS_OUT_PACKET_SIZE)
+    {
+        return USBD_OK;
+    }
+    usb_rx_hold[port] = 1;
+    return USBD_BUSY;
 }
 
-/* Error callback */
-void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+/* Line coding requested by the host: apply it to the UART
+ * Supported: 8 data bits with none/odd/even parity, 7 data bits without parity, 1, 1.5 or 2 stop bits.
+ * The parity bit is included in the word length of the UART. 7 data bits with parity are rejected: the parity
+ * bit is received in bit 7 of the data register and the byte-wide DMA would pass it on as data.
+*/
+uint8_t CDC_LineCodingCallback(uint8_t port, USBD_CDC_LineCodingTypeDef* coding)
 {
-    Error_Handler();
+    static const uint32_t stopbits[3] = { UART_STOPBITS_1, UART_STOPBITS_1_5, UART_STOPBITS_2 };
+    static const uint32_t parity[3] = { UART_PARITY_NONE, UART_PARITY_ODD, UART_PARITY_EVEN };
+    uint32_t bits;
+    
+    if(coding->bitrate == 0 || coding->format > 2 || coding->paritytype > 2 || (coding->datatype != 7 && coding->datatype != 8) ||
+       (coding->datatype == 7 && coding->paritytype != 0))
+    {
+        return USBD_FAIL;
+    }
+    
+    bits = coding->datatype + (coding->paritytype ? 1 : 0);
+    
+    if(UART_DMA_SetLineCoding(&uart_dma[port], coding->bitrate,
+                              (bits == 9) ? UART_WORDLENGTH_9B : (bits == 8) ? UART_WORDLENGTH_8B : UART_WORDLENGTH_7B,
+                              stopbits[coding->format], parity[coding->paritytype]) != HAL_OK)
+    {
+        return USBD_FAIL;
+    }
+    return USBD_OK;
 }
 
-/* UART2 Configuration */
-void UART_Init(void)
+/* Vendor command over CDC_SEND_ENCAPSULATED_COMMAND: first byte is the command code (STATS_CMD_xxx) */
+void CDC_CommandCallback(uint8_t* Buf, uint16_t Len)
 {
-    huart2.Instance = USART2;
-    huart2.Init.BaudRate = 115200;
-    huart2.Init.WordLength = UART_WORDLENGTH_8B;
-    huart2.Init.StopBits = UART_STOPBITS_1;
-    huart2.Init.Parity = UART_PARITY_NONE;
-    huart2.Init.Mode = UART_MODE_TX_RX;
-    huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
-    huart2.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
-    huart2.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
-    if(HAL_UART_Init(&huart2) != HAL_OK)
+    if(Len == 0)
     {
-        Error_Handler();
+        return;
     }
     
-    /* UART2 IDLE Interrupt Configuration */
-    SET_BIT(USART2->CR1, USART_CR1_IDLEIE);
-    HAL_NVIC_SetPriority(USART2_IRQn, 0, 0);
-    HAL_NVIC_EnableIRQ(USART2_IRQn);
+    usb_cmd = Buf[0];
+    if(usb_cmd == STATS_CMD_RESET)
+    {
+        Stats_Reset();
+    }
 }
 
-/* DMA Configuration */
-void DMA_Init(void)
+/* Response of the vendor command over CDC_GET_ENCAPSULATED_RESPONSE */
+void CDC_ResponseCallback(uint8_t* Buf, uint16_t Len)
 {
-    __HAL_RCC_DMA1_CLK_ENABLE();
+    /* Only the statistics snapshot is reported */
+    if(Len > sizeof(Stats_t))
+    {
+        Len = sizeof(Stats_t);
+    }
     
-    hdma_usart2_rx.Instance = DMA1_Channel6;
-    hdma_usart2_rx.Init.Request = DMA_REQUEST_2;
-    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
-    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
-    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
-    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
-    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
-    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
-    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_VERY_HIGH;
-    if(HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK)
+    memset(Buf, 0, Len);
+    if(usb_cmd == STATS_CMD_READ)
     {
-        Error_Handler();
+        Stats_Read(Buf, Len);
     }
-            
-    __HAL_LINKDMA(&huart2,hdmarx, hdma_usart2_rx);
+}
+
+/* Space freed in the UART TX ring: resume USB OUT reception */
+static void UART_TxReady(UART_DMA_t* ch)
+{
+    uint8_t port = USB_PORT(ch);
     
-    /* DMA Interrupt Configuration */
-    HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 0, 0);
-    HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+    if(usb_rx_hold[port] && UART_DMA_TxFree(ch) >= CDC_DATA_FS_OUT_PACKET_SIZE)
+    {
+        usb_rx_hold[port] = 0;
+        CDC_ReceiveNext_FS(port);
+    }
 }
 
 /* GPIO Configuration */
@@ -0,0 +1,231 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   ring.c
+  * @brief  Byte ring with free-running indices
+  *         This file contains the ring buffer of power of two size used for
+  *         the DMA buffers. Positions are derived from the free-running
+  *         indices by masking, thus the byte counts need no wraparound check.
+  *         Data is copied in and out in at most two segments with word-wide
+  *         block transfers.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "ring.h"
+
+/* Private function prototypes -----------------------------------------------*/
+static void Ring_Copy(uint8_t* dst, const uint8_t* src, uint32_t len);
+
+/**
+  * @brief  Initialize an empty ring
+  * @param  r: ring
+  * @param  buf: storage
+  * @param  size: storage size in bytes, must be a power of two (see RING_IS_POW2)
+  * @retval None
+  */
+void Ring_Init(Ring_t* r, uint8_t* buf, uint32_t size)
+{
+    r->buf = buf;
+    r->mask = size - 1;
+    r->wr = 0;
+    r->rd = 0;
+}
+
+/**
+  * @brief  Copy data into the ring and advance the write index
+  * @param  r: ring
+  * @param  data: data to be written
+  * @param  len: number of bytes
+  * @retval Number of bytes written, less than len if the ring is full
+  */
+uint32_t Ring_Write(Ring_t* r, const uint8_t* data, uint32_t len)
+{
+    uint32_t wr = r->wr;
+    uint32_t pos = wr & r->mask;
+    uint32_t first = RING_SIZE(r) - pos;
+
+    if(len > RING_FREE(r))
+    {
+        len = RING_FREE(r);
+    }
+
+    if(len <= first)
+    {
+        Ring_Copy(&r->buf[pos], data, len);
+    }
+    else
+    {
+        Ring_Copy(&r->buf[pos], data, first);
+        Ring_Copy(&r->buf[0], &data[first], len - first);
+    }
+
+    r->wr = wr + len;
+    return len;
+}
+
+/**
+  * @brief  Copy data out of the ring into a linear buffer and advance the read index
+  * @param  r: ring
+  * @param  dst: destination
+  * @param  len: number of bytes
+  * @retval Number of bytes read, less than len if the ring holds less data
+  */
+uint32_t Ring_Read(Ring_t* r, uint8_t* dst, uint32_t len)
+{
+    uint32_t rd = r->rd;
+    uint32_t pos = rd & r->mask;
+    uint32_t first = RING_SIZE(r) - pos;
+
+    if(len > RING_COUNT(r))
+    {
+        len = RING_COUNT(r);
+    }
+
+    if(len <= first)
+    {
+        Ring_Copy(dst, &r->buf[pos], len);
+    }
+    else
+    {
+        Ring_Copy(dst, &r->buf[pos], first);
+        Ring_Copy(&dst[first], &r->buf[0], len - first);
+    }
+
+    r->rd = rd + len;
+    return len;
+}
+
+/**
+  * @brief  Get the number of bytes that can be read without wrapping around the ring end
+  * @param  r: ring
+  * @retval Number of contiguous bytes at the read index
+  */
+uint32_t Ring_Contiguous(const Ring_t* r)
+{
+    uint32_t count = RING_COUNT(r);
+    uint32_t first = RING_SIZE(r) - (r->rd & r->mask);
+
+    return (count < first) ? count : first;
+}
+
+/**
+  * @brief  Get unread data as up to two contiguous spans
+  * @param  r: ring
+  * @param  span: array of two spans
+  * @retval Number of valid spans
+  */
+uint8_t Ring_GetSpans(const Ring_t* r, RingSpan_t* span)
+{
+    uint32_t count = RING_COUNT(r);
+    uint32_t first = Ring_Contiguous(r);
+
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    span[0].ptr = &r->buf[r->rd & r->mask];
+    span[0].len = first;
+    if(count == first)
+    {
+        return 1;
+    }
+
+    span[1].ptr = &r->buf[0];
+    span[1].len = count - first;
+    return 2;
+}
+
+/**
+  * @brief  Advance the read index
+  * @param  r: ring
+  * @param  len: number of bytes read, limited to the ring content
+  * @retval None
+  */
+void Ring_Release(Ring_t* r, uint32_t len)
+{
+    uint32_t count = RING_COUNT(r);
+
+    r->rd += (len < count) ? len : count;
+}
+
+/** Block copy
+ * The destination is aligned to a word boundary with byte copies, then the data is moved in words
+ * (chunks shorter than two words are copied by bytes):
+ *  - Source aligned as well: 16 bytes per iteration with four word loads and stores (LDM/STM).
+ *  - Source misaligned: aligned word loads, each destination word is merged from two source words by shifting,
+ *    thus there is no unaligned access and no byte loop in the bulk of the copy. The source words are read
+ *    within the words that hold source data only.
+ * The remaining bytes at the end are copied one by one.
+*/
+static void Ring_Copy(uint8_t* dst, const uint8_t* src, uint32_t len)
+{
+    uint32_t* d;
+    const uint32_t* s;
+    uint32_t shift, w0, w1;
+    uint32_t head = (0 - (uint32_t)(uintptr_t)dst) & 3;
+
+    /* Short chunks are copied by bytes */
+    if(len < 8)
+    {
+        head = len;
+    }
+
+    len -= head;
+    while(head--)
+    {
+        *dst++ = *src++;
+    }
+
+    if(len >= 4)
+    {
+        d = (uint32_t*)dst;
+        shift = ((uint32_t)(uintptr_t)src & 3) * 8;
+
+        if(shift == 0)
+        {
+            s = (const uint32_t*)src;
+            while(len >= 16)
+            {
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+                d[3] = s[3];
+                d += 4;
+                s += 4;
+                len -= 16;
+            }
+            while(len >= 4)
+            {
+                *d++ = *s++;
+                len -= 4;
+            }
+        }
+        else
+        {
+            /* Little-endian: the lower bytes of the destination word come from the upper bytes of w0 */
+            s = (const uint32_t*)(src - shift / 8);
+            w0 = *s++;
+            while(len >= 4)
+            {
+                w1 = *s++;
+                *d++ = (w0 >> shift) | (w1 << (32 - shift));
+                w0 = w1;
+                len -= 4;
+            }
+        }
+
+        src += (uint8_t*)d - dst;
+        dst = (uint8_t*)d;
+    }
+
+    while(len--)
+    {
+        *dst++ = *src++;
+    }
+}
@@ -0,0 +1,94 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   rx_queue.c
+  * @brief  RX event queue
+  *         This file contains a lock-free single-producer single-consumer
+  *         queue that passes received data descriptors from interrupt
+  *         context to the deferred worker.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32l4xx.h"
+#include "rx_queue.h"
+
+#if (RX_QUEUE_SIZE & (RX_QUEUE_SIZE - 1)) != 0
+#error "RX_QUEUE_SIZE must be a power of two"
+#endif
+
+/**
+  * @brief  Push a descriptor to the queue (producer side)
+  * @param  q: queue
+  * @param  chunk: descriptor to be copied into the queue
+  * @retval 1 on success, 0 if the queue is full
+  */
+uint8_t RxQueue_Push(RxQueue_t* q, const RxChunk_t* chunk)
+{
+    uint32_t head = q->head;
+    
+    if((head - q->tail) >= RX_QUEUE_SIZE)
+    {
+        return 0;
+    }
+    
+    q->item[head & (RX_QUEUE_SIZE - 1)] = *chunk;
+    
+    /* Entry has to be written before it is published to the consumer */
+    __DMB();
+    q->head = head + 1;
+    
+    return 1;
+}
+
+/**
+  * @brief  Pop a descriptor from the queue (consumer side)
+  * @param  q: queue
+  * @param  chunk: destination of the descriptor
+  * @retval 1 on success, 0 if the queue is empty
+  */
+uint8_t RxQueue_Pop(RxQueue_t* q, RxChunk_t* chunk)
+{
+    uint32_t tail = q->tail;
+    
+    if(tail == q->head)
+    {
+        return 0;
+    }
+    
+    *chunk = q->item[tail & (RX_QUEUE_SIZE - 1)];
+    
+    /* Entry has to be read before the slot is given back to the producer */
+    __DMB();
+    q->tail = tail + 1;
+    
+    return 1;
+}
+
+/**
+  * @brief  Extend the newest descriptor with a later one, e.g. if the queue is full (producer side)
+  * @param  q: queue
+  * @param  chunk: descriptor to be merged: its end and stamp replace the end and stamp, its flags are added to the flags
+  * @retval 1 on success, 0 if there are less than two entries (the consumer may be reading the newest one)
+  */
+uint8_t RxQueue_Merge(RxQueue_t* q, const RxChunk_t* chunk)
+{
+    uint32_t head = q->head;
+    RxChunk_t* last;
+    
+    if((head - q->tail) < 2)
+    {
+        return 0;
+    }
+    
+    last = &q->item[(head - 1) & (RX_QUEUE_SIZE - 1)];
+    last->end = chunk->end;
+    last->stamp = chunk->stamp;
+    last->flags |= chunk->flags;
+    
+    return 1;
+}
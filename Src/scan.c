@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   scan.c
+  * @brief  Delimiter scanner
+  *         This file contains the streaming delimiter scanner of a ring. It
+  *         splits the received data into delimiter-terminated records (lines
+  *         or frames) that are returned as spans into the ring, without copy.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "scan.h"
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t Scan_Record(Scan_t* s, const Ring_t* r, uint32_t end, RingSpan_t* span);
+
+/**
+  * @brief  Initialize the scanner
+  * @param  s: scanner
+  * @param  delim: record delimiter
+  * @retval None
+  */
+void Scan_Init(Scan_t* s, uint8_t delim)
+{
+    s->start = 0;
+    s->pos = 0;
+    s->delim = delim;
+    s->pattern = delim * 0x01010101U;
+}
+
+/** Incremental scan
+ * The scan position is kept between the calls, thus every byte is scanned only once, no matter how the data
+ * is cut by DMA and timeout events. Aligned words are tested for the delimiter at once: the word is XOR-ed
+ * with the delimiter pattern, and ((v - 0x01010101) & ~v & 0x80808080) is nonzero if and only if a byte of v
+ * is zero, i.e. the word holds a delimiter. Such a word is resolved byte by byte. A word is tested only if it
+ * ends before the ring end, thus the ring storage need not be word aligned (the bytes at the wrap are tested
+ * one by one).
+ * Remarks:
+ *  - A record is returned as one or two spans pointing into the ring (two spans when it wraps around the
+ *    ring end), the delimiter is included. The consumer releases the record from the ring when it is no
+ *    longer needed; records can be released one by one or together.
+ *  - A record longer than the ring cannot be completed. When the ring is full without a delimiter, the ring
+ *    content is returned as a record without delimiter, so that the consumer can drop it.
+ *  - If the consumer releases data beyond the record start (or the ring is resynchronized after an overrun),
+ *    the scanner continues from the read index.
+*/
+
+/**
+  * @brief  Get the next complete record
+  * @param  s: scanner
+  * @param  r: ring
+  * @param  span: array of two spans
+  * @retval Number of valid spans, 0 if there is no complete record yet
+  */
+uint8_t Scan_Next(Scan_t* s, const Ring_t* r, RingSpan_t* span)
+{
+    uint32_t rd = r->rd;
+    uint32_t wr = r->wr;
+    uint32_t pos, v;
+    const uint8_t* p;
+
+    /* Data before the record start has been released or overwritten */
+    if((int32_t)(rd - s->start) > 0)
+    {
+        s->start = rd;
+    }
+    if((int32_t)(s->start - s->pos) > 0)
+    {
+        s->pos = s->start;
+    }
+
+    pos = s->pos;
+    while(pos != wr)
+    {
+        p = &r->buf[pos & r->mask];
+
+        /* Whole aligned word available before the ring end: skip it if it holds no delimiter */
+        if(((uint32_t)(uintptr_t)p & 3) == 0 && (wr - pos) >= 4 && (pos & r->mask) + 4 <= RING_SIZE(r))
+        {
+            v = *(const uint32_t*)p ^ s->pattern;
+            if(((v - 0x01010101U) & ~v & 0x80808080U) == 0)
+            {
+                pos += 4;
+                continue;
+            }
+        }
+
+        if(*p == s->delim)
+        {
+            return Scan_Record(s, r, pos + 1, span);
+        }
+        ++pos;
+    }
+    s->pos = pos;
+
+    /* Ring is full without delimiter */
+    if(wr - s->start >= RING_SIZE(r))
+    {
+        return Scan_Record(s, r, s->start + RING_SIZE(r), span);
+    }
+
+    return 0;
+}
+
+/**
+  * @brief  Get the incomplete record, e.g. at the end of transmission (timeout event)
+  * @param  s: scanner
+  * @param  r: ring
+  * @param  span: array of two spans
+  * @retval Number of valid spans, 0 if there is no data after the last record
+  */
+uint8_t Scan_Flush(Scan_t* s, const Ring_t* r, RingSpan_t* span)
+{
+    if((int32_t)(r->rd - s->start) > 0)
+    {
+        s->start = r->rd;
+    }
+
+    if(r->wr == s->start)
+    {
+        return 0;
+    }
+    return Scan_Record(s, r, r->wr, span);
+}
+
+/* Return the record from the start till end as spans, the next record starts at end */
+static uint8_t Scan_Record(Scan_t* s, const Ring_t* r, uint32_t end, RingSpan_t* span)
+{
+    uint32_t start = s->start & r->mask;
+    uint32_t len = end - s->start;
+    uint32_t first = RING_SIZE(r) - start;
+
+    s->start = end;
+    s->pos = end;
+
+    span[0].ptr = &r->buf[start];
+    if(len <= first)
+    {
+        span[0].len = len;
+        return 1;
+    }
+
+    span[0].len = first;
+    span[1].ptr = &r->buf[0];
+    span[1].len = len - first;
+    return 2;
+}
@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   stats.c
+  * @brief  RX path statistics
+  *         This file contains the event counters of the RX path and the
+  *         latency histogram measured with the DWT cycle counter.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "stats.h"
+
+/* Private variables ---------------------------------------------------------*/
+Stats_t stats;
+
+static uint32_t stats_epoch = 1;        /* Incremented at reset: drops the latency measurements in progress */
+
+/**
+  * @brief  Enable the DWT cycle counter and clear the statistics
+  * @param  None
+  * @retval None
+  */
+void Stats_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    Stats_Reset();
+}
+
+/**
+  * @brief  Clear the statistics
+  * @param  None
+  * @retval None
+  */
+void Stats_Reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    memset(&stats, 0, sizeof(stats));
+    if(++stats_epoch == 0)
+    {
+        stats_epoch = 1;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Copy a consistent snapshot of the statistics
+  * @param  buf: destination buffer
+  * @param  len: size of the destination buffer
+  * @retval Number of bytes copied
+  */
+uint16_t Stats_Read(uint8_t* buf, uint16_t len)
+{
+    uint32_t primask;
+
+    if(len > sizeof(stats))
+    {
+        len = sizeof(stats);
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(buf, &stats, len);
+    __set_PRIMASK(primask);
+
+    return len;
+}
+
+/* Update the longest interrupt duration */
+void Stats_IsrDuration(uint32_t cycles)
+{
+    if(cycles > stats.isr_max_cycles)
+    {
+        stats.isr_max_cycles = cycles;
+    }
+}
+
+/* Idle event (end of transmission detected by the UART): start of the latency measurement of the port */
+void Stats_IdleEvent(Stats_Latency_t* lat)
+{
+    lat->stamp = DWT->CYCCNT;
+    lat->epoch = stats_epoch;
+}
+
+/* End of transmission submitted to the USB: end of the latency measurement of the port */
+void Stats_UsbSubmit(Stats_Latency_t* lat)
+{
+    uint32_t usec;
+    uint32_t bin;
+
+    if(lat->epoch != stats_epoch)
+    {
+        return;
+    }
+    lat->epoch = 0;
+
+    usec = (DWT->CYCCNT - lat->stamp) / (SystemCoreClock / 1000000);
+    bin = (usec == 0) ? 0 : (31 - __CLZ(usec));
+    if(bin >= STATS_HIST_BINS)
+    {
+        bin = STATS_HIST_BINS - 1;
+    }
+    ++stats.latency[bin];
+}
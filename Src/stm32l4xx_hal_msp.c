@@ -28,38 +28,134 @@ void HAL_MspInit(void)
     HAL_NVIC_SetPriority(UsageFault_IRQn, 0, 0);
     HAL_NVIC_SetPriority(SVCall_IRQn, 0, 0);
     HAL_NVIC_SetPriority(DebugMonitor_IRQn, 0, 0);
-    HAL_NVIC_SetPriority(PendSV_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(PendSV_IRQn, 15, 0);    /* Lowest priority: deferred RX worker */
     HAL_NVIC_SetPriority(SysTick_IRQn, 0, 0);
 }
 
+/* UART GPIO Configuration
+ * USART2 is connected to the ST-Link VCP of the 32L476G Discovery kit.
+ * The pins of the other ports are the default mapping of STM32L476VG, adapt them to the board if necessary.
+*/
 void HAL_UART_MspInit(UART_HandleTypeDef* huart)
 {
     GPIO_InitTypeDef GPIO_InitStruct;
+    GPIO_TypeDef* port;
     
-    if(huart->Instance == USART2)
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    
+    if(huart->Instance == USART1)
+    {
+        __HAL_RCC_USART1_CLK_ENABLE();
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+
+        /* PB6 --> USART1_TX, PB7 --> USART1_RX */
+        GPIO_InitStruct.Pin = GPIO_PIN_6 | GPIO_PIN_7;
+        GPIO_InitStruct.Alternate = GPIO_AF7_USART1;
+        port = GPIOB;
+    }
+    else if(huart->Instance == USART2)
     {
         __HAL_RCC_USART2_CLK_ENABLE();
+        __HAL_RCC_GPIOD_CLK_ENABLE();
 
         /* UART2 GPIO Configuration    
         PD5     --> USART2_TX
         PD6     --> USART2_RX 
         */
         GPIO_InitStruct.Pin = GPIO_PIN_5 | GPIO_PIN_6;
-        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-        GPIO_InitStruct.Pull = GPIO_PULLUP;
-        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
         GPIO_InitStruct.Alternate = GPIO_AF7_USART2;
+        port = GPIOD;
+    }
+    else if(huart->Instance == USART3)
+    {
+        __HAL_RCC_USART3_CLK_ENABLE();
+        __HAL_RCC_GPIOC_CLK_ENABLE();
+
+        /* PC4 --> USART3_TX, PC5 --> USART3_RX */
+        GPIO_InitStruct.Pin = GPIO_PIN_4 | GPIO_PIN_5;
+        GPIO_InitStruct.Alternate = GPIO_AF7_USART3;
+        port = GPIOC;
+    }
+    else if(huart->Instance == UART4)
+    {
+        __HAL_RCC_UART4_CLK_ENABLE();
+        __HAL_RCC_GPIOA_CLK_ENABLE();
+
+        /* PA0 --> UART4_TX, PA1 --> UART4_RX */
+        GPIO_InitStruct.Pin = GPIO_PIN_0 | GPIO_PIN_1;
+        GPIO_InitStruct.Alternate = GPIO_AF8_UART4;
+        port = GPIOA;
+    }
+    else if(huart->Instance == UART5)
+    {
+        __HAL_RCC_UART5_CLK_ENABLE();
+        __HAL_RCC_GPIOC_CLK_ENABLE();
+        __HAL_RCC_GPIOD_CLK_ENABLE();
+
+        /* PC12 --> UART5_TX, PD2 --> UART5_RX */
+        GPIO_InitStruct.Pin = GPIO_PIN_2;
+        GPIO_InitStruct.Alternate = GPIO_AF8_UART5;
         HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
+        GPIO_InitStruct.Pin = GPIO_PIN_12;
+        port = GPIOC;
     }
+    else if(huart->Instance == LPUART1)
+    {
+        __HAL_RCC_LPUART1_CLK_ENABLE();
+        __HAL_RCC_GPIOC_CLK_ENABLE();
+
+        /* PC1 --> LPUART1_TX, PC0 --> LPUART1_RX */
+        GPIO_InitStruct.Pin = GPIO_PIN_0 | GPIO_PIN_1;
+        GPIO_InitStruct.Alternate = GPIO_AF8_LPUART1;
+        port = GPIOC;
+    }
+    else
+    {
+        return;
+    }
+    
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
 }
 
 void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
 {
-    if(huart->Instance == USART2)
+    if(huart->Instance == USART1)
+    {
+        __HAL_RCC_USART1_CLK_DISABLE();
+        HAL_GPIO_DeInit(GPIOB, GPIO_PIN_6 | GPIO_PIN_7);
+    }
+    else if(huart->Instance == USART2)
     {
         __HAL_RCC_USART2_CLK_DISABLE();
         HAL_GPIO_DeInit(GPIOD, GPIO_PIN_5 | GPIO_PIN_6);
-        HAL_DMA_DeInit(huart->hdmarx);
     }
+    else if(huart->Instance == USART3)
+    {
+        __HAL_RCC_USART3_CLK_DISABLE();
+        HAL_GPIO_DeInit(GPIOC, GPIO_PIN_4 | GPIO_PIN_5);
+    }
+    else if(huart->Instance == UART4)
+    {
+        __HAL_RCC_UART4_CLK_DISABLE();
+        HAL_GPIO_DeInit(GPIOA, GPIO_PIN_0 | GPIO_PIN_1);
+    }
+    else if(huart->Instance == UART5)
+    {
+        __HAL_RCC_UART5_CLK_DISABLE();
+        HAL_GPIO_DeInit(GPIOC, GPIO_PIN_12);
+        HAL_GPIO_DeInit(GPIOD, GPIO_PIN_2);
+    }
+    else if(huart->Instance == LPUART1)
+    {
+        __HAL_RCC_LPUART1_CLK_DISABLE();
+        HAL_GPIO_DeInit(GPIOC, GPIO_PIN_0 | GPIO_PIN_1);
+    }
+    else
+    {
+        return;
+    }
+    
+    HAL_DMA_DeInit(huart->hdmarx);
 }
-
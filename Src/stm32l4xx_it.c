@@ -17,11 +17,10 @@
 #include "stm32l4xx_hal.h"
 #include "stm32l4xx_it.h"
 #include "main.h"
+#include "uart_dma.h"
 
 /* External variables --------------------------------------------------------*/
 extern PCD_HandleTypeDef hpcd_USB_OTG_FS;
-extern DMA_HandleTypeDef hdma_usart2_rx;
-extern DMA_Event_t dma_uart_rx;
 
 /******************************************************************************/
 /*            Cortex-M4 Processor Interruption and Exception Handlers         */ 
@@ -96,7 +95,8 @@ void DebugMon_Handler(void)
 */
 void PendSV_Handler(void)
 {
-
+    /* Deferred RX processing */
+    UART_DMA_Process();
 }
 
 /**
@@ -107,37 +107,121 @@ void SysTick_Handler(void)
     HAL_IncTick();
     HAL_SYSTICK_IRQHandler();
     
-    /* DMA timer */
-    if(dma_uart_rx.timer == 1)
-    {
-        /* DMA Timeout event: set Timeout Flag and call DMA Rx Complete Callback */
-        dma_uart_rx.flag = 1;
-        hdma_usart2_rx.XferCpltCallback(&hdma_usart2_rx);
-    }
-    if(dma_uart_rx.timer) { --dma_uart_rx.timer; }
+    /* DMA timers */
+    UART_DMA_TickHandler();
 }
 
 /******************************************************************************/
 /* STM32L4xx Peripheral Interrupt Handlers                                    */
 /******************************************************************************/
+/**
+* @brief These functions handle the UART global interrupts.
+*/
+void USART1_IRQHandler(void)
+{
+    UART_DMA_IRQHandler(UART_DMA_USART1);
+}
+
 void USART2_IRQHandler(void)
-{   
-    /* UART IDLE Interrupt */
-    if((USART2->ISR & USART_ISR_IDLE) != RESET)
-    {
-        USART2->ICR = UART_CLEAR_IDLEF;
-        /* Start DMA timer */
-        dma_uart_rx.timer = DMA_TIMEOUT_MS;
-    }
+{
+    UART_DMA_IRQHandler(UART_DMA_USART2);
+}
+
+void USART3_IRQHandler(void)
+{
+    UART_DMA_IRQHandler(UART_DMA_USART3);
+}
+
+void UART4_IRQHandler(void)
+{
+    UART_DMA_IRQHandler(UART_DMA_UART4);
+}
+
+void UART5_IRQHandler(void)
+{
+    UART_DMA_IRQHandler(UART_DMA_UART5);
+}
+
+void LPUART1_IRQHandler(void)
+{
+    UART_DMA_IRQHandler(UART_DMA_LPUART1);
 }
 
 /**
-* @brief This function handles DMA1 channel6 global interrupt.
+* @brief These functions handle the DMA channel global interrupts of the UART receivers.
 */
+void DMA1_Channel5_IRQHandler(void)
+{
+    UART_DMA_RxIRQHandler(UART_DMA_USART1);
+}
+
 void DMA1_Channel6_IRQHandler(void)
 {
-    HAL_DMA_IRQHandler(&hdma_usart2_rx);
+    UART_DMA_RxIRQHandler(UART_DMA_USART2);
+}
+
+void DMA1_Channel3_IRQHandler(void)
+{
+    UART_DMA_RxIRQHandler(UART_DMA_USART3);
+}
+
+void DMA2_Channel5_IRQHandler(void)
+{
+    UART_DMA_RxIRQHandler(UART_DMA_UART4);
+}
+
+void DMA2_Channel2_IRQHandler(void)
+{
+    UART_DMA_RxIRQHandler(UART_DMA_UART5);
+}
+
+void DMA2_Channel7_IRQHandler(void)
+{
+    UART_DMA_RxIRQHandler(UART_DMA_LPUART1);
+}
+
+/**
+* @brief These functions handle the DMA channel global interrupts of the UART transmitters.
+*/
+void DMA1_Channel4_IRQHandler(void)
+{
+    UART_DMA_TxIRQHandler(UART_DMA_USART1);
+}
+
+void DMA1_Channel7_IRQHandler(void)
+{
+    UART_DMA_TxIRQHandler(UART_DMA_USART2);
+}
+
+void DMA1_Channel2_IRQHandler(void)
+{
+    UART_DMA_TxIRQHandler(UART_DMA_USART3);
+}
+
+void DMA2_Channel3_IRQHandler(void)
+{
+    UART_DMA_TxIRQHandler(UART_DMA_UART4);
+}
+
+void DMA2_Channel1_IRQHandler(void)
+{
+    UART_DMA_TxIRQHandler(UART_DMA_UART5);
+}
+
+void DMA2_Channel6_IRQHandler(void)
+{
+    UART_DMA_TxIRQHandler(UART_DMA_LPUART1);
+}
+
+#if (DMA_M2M_ENABLE == 1)
+/**
+* @brief This function handles the DMA channel global interrupt of the memory-to-memory transfers.
+*/
+void DMA1_Channel1_IRQHandler(void)
+{
+    UART_DMA_M2MIRQHandler();
 }
+#endif
 
 /**
 * @brief This function handles USB OTG FS global interrupt.
@@ -0,0 +1,1333 @@
+/**
+  ******************************************************************************
+  * STM32L4 UART DMA implementation with Timeout Event
+  ******************************************************************************
+  * @author Akos Pasztor
+  * @file   uart_dma.c
+  * @brief  UART DMA RX engine
+  *         This file contains the reusable RX engine of the circular DMA with
+  *         timeout event. One channel object is instantiated per serial port,
+  *         all ports share the same interrupt and processing code path.
+  *         Optionally, the transmitter is fed by DMA from a TX ring.
+  ******************************************************************************
+  * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "uart_dma.h"
+#include "stats.h"
+
+/* Defines -------------------------------------------------------------------*/
+/* Adaptive DMA Timeout */
+#define DMA_ADAPT_WARMUP    8       /* Gaps measured before the timeout is adapted */
+#define DMA_ADAPT_AGING     64      /* Gaps between two halvings of the histogram */
+
+/* Private variables ---------------------------------------------------------*/
+/* Hardware resources of the serial ports (see RM0351 DMA request mapping) */
+static const UART_DMA_Port_t uart_dma_port[UART_DMA_PORT_COUNT] =
+{
+    { USART1,  USART1_IRQn,  DMA1_Channel5, DMA_REQUEST_2, DMA1_Channel5_IRQn, DMA1_Channel4, DMA_REQUEST_2, DMA1_Channel4_IRQn },
+    { USART2,  USART2_IRQn,  DMA1_Channel6, DMA_REQUEST_2, DMA1_Channel6_IRQn, DMA1_Channel7, DMA_REQUEST_2, DMA1_Channel7_IRQn },
+    { USART3,  USART3_IRQn,  DMA1_Channel3, DMA_REQUEST_2, DMA1_Channel3_IRQn, DMA1_Channel2, DMA_REQUEST_2, DMA1_Channel2_IRQn },
+    { UART4,   UART4_IRQn,   DMA2_Channel5, DMA_REQUEST_2, DMA2_Channel5_IRQn, DMA2_Channel3, DMA_REQUEST_2, DMA2_Channel3_IRQn },
+    { UART5,   UART5_IRQn,   DMA2_Channel2, DMA_REQUEST_2, DMA2_Channel2_IRQn, DMA2_Channel1, DMA_REQUEST_2, DMA2_Channel1_IRQn },
+    { LPUART1, LPUART1_IRQn, DMA2_Channel7, DMA_REQUEST_4, DMA2_Channel7_IRQn, DMA2_Channel6, DMA_REQUEST_4, DMA2_Channel6_IRQn },
+};
+
+/* Active channels, indexed by port */
+static UART_DMA_t* uart_dma_channel[UART_DMA_PORT_COUNT];
+
+#if (DMA_M2M_ENABLE == 1)
+/* Memory-to-memory DMA channel, shared by all serial ports */
+static DMA_HandleTypeDef uart_dma_m2m;
+static UART_DMA_t* uart_dma_m2m_owner;          /* Channel of the transfer in progress */
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static void UART_DMA_Timeout(UART_DMA_t* ch);
+#if (DMA_MATCH_ENABLE == 1)
+static void UART_DMA_Match(UART_DMA_t* ch);
+#endif
+static void UART_DMA_SetTimeout(UART_DMA_t* ch, uint32_t baudrate, uint32_t bits);
+static void UART_DMA_CharTime(UART_DMA_t* ch);
+#if (UART_DMA_STAMP == 1)
+static void UART_DMA_Stamp(UART_DMA_t* ch, uint32_t bits);
+#endif
+#if (DMA_ADAPT_ENABLE == 1)
+static void UART_DMA_AdaptInit(UART_DMA_t* ch);
+static void UART_DMA_Adapt(UART_DMA_t* ch);
+#endif
+static uint32_t UART_DMA_WriteIndex(UART_DMA_t* ch);
+static void UART_DMA_RxError(UART_DMA_t* ch, uint32_t isr);
+#if (UART_ERROR_MARK == 1)
+static void UART_DMA_Mark(UART_DMA_t* ch, uint32_t wr);
+#endif
+static void UART_DMA_Update(UART_DMA_t* ch, uint8_t flags);
+static void UART_DMA_Publish(UART_DMA_t* ch, uint32_t end, uint8_t flags);
+static void UART_DMA_Commit(UART_DMA_t* ch, uint32_t end);
+static uint8_t UART_DMA_PassHole(UART_DMA_t* ch, uint32_t* end);
+static void UART_DMA_TxStart(UART_DMA_t* ch);
+static void UART_DMA_TxCplt(DMA_HandleTypeDef* hdma);
+static void UART_DMA_ReadComplete(UART_DMA_t* ch);
+#if (DMA_M2M_ENABLE == 1)
+static void UART_DMA_M2MInit(void);
+static void UART_DMA_M2MCplt(DMA_HandleTypeDef* hdma);
+#endif
+
+/**
+  * @brief  Initialize the RX engine of a serial port
+  * @param  ch: channel object
+  * @param  id: serial port
+  * @param  baudrate: baud rate in bits/sec
+  * @param  buf: circular buffer for DMA
+  * @param  size: circular buffer size in bytes, power of two
+  * @param  sink: consumer of the received data, called from the RX worker
+  * @retval None
+  */
+void UART_DMA_Init(UART_DMA_t* ch, UART_DMA_PortId_t id, uint32_t baudrate, uint8_t* buf, uint16_t size, UART_DMA_Sink_t sink)
+{
+    const UART_DMA_Port_t* port = &uart_dma_port[id];
+
+    /* Positions are computed with mask arithmetic */
+    if(!RING_IS_POW2(size))
+    {
+        Error_Handler();
+    }
+
+    ch->port = port;
+    ch->buf = buf;
+    ch->size = size;
+    ch->sink = sink;
+    ch->carry.end = 0;
+    ch->carry.flags = 0;
+    ch->end = 0;
+    ch->flush = 0;
+    ch->queue.head = 0;
+    ch->queue.tail = 0;
+    ch->stamps.head = 0;
+    ch->stamps.tail = 0;
+    ch->stamp.end = 0;
+    ch->read.state = UART_DMA_READ_IDLE;
+    ch->latency.epoch = 0;
+    Ring_Init(&ch->rx, buf, size);
+
+    ch->event.flag = 0;
+    ch->event.timer = 0;
+    ch->event.base = 0;
+    ch->event.wr = 0;
+    ch->event.stamp = 0;
+    ch->event.stampWr = 0;
+    ch->event.marked = 0;
+    ch->event.holes = 0;
+
+    /* LPUART has no receiver timeout, it always uses the SysTick engine */
+    ch->engine = (port->instance == LPUART1) ? DMA_TIMEOUT_SYSTICK : DMA_TIMEOUT_ENGINE;
+    UART_DMA_SetTimeout(ch, baudrate, DMA_TIMEOUT_BITS);
+
+    /* UART Configuration */
+    ch->huart.Instance = port->instance;
+    ch->huart.Init.BaudRate = baudrate;
+    ch->huart.Init.WordLength = UART_WORDLENGTH_8B;
+    ch->huart.Init.StopBits = UART_STOPBITS_1;
+    ch->huart.Init.Parity = UART_PARITY_NONE;
+    ch->huart.Init.Mode = UART_MODE_TX_RX;
+    ch->huart.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    ch->huart.Init.OverSampling = UART_OVERSAMPLING_16;
+    ch->huart.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+    ch->huart.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+    if(HAL_UART_Init(&ch->huart) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    UART_DMA_CharTime(ch);
+
+    if(ch->engine == DMA_TIMEOUT_RTO)
+    {
+        /* UART Receiver Timeout Configuration:
+         * RTOF is set when no new start bit is detected for timeout bit-times after the last stop bit.
+         * The counter is restarted by every received character, thus the flag is set only once per transmission.
+        */
+        __HAL_UART_DISABLE(&ch->huart);
+        WRITE_REG(port->instance->RTOR, ch->timeout & USART_RTOR_RTO);
+        SET_BIT(port->instance->CR2, USART_CR2_RTOEN);
+        __HAL_UART_ENABLE(&ch->huart);
+        SET_BIT(port->instance->CR1, USART_CR1_RTOIE);
+    }
+    if(ch->engine == DMA_TIMEOUT_SYSTICK || DMA_ADAPT_ENABLE)
+    {
+        /* UART IDLE Interrupt Configuration (RTO engine: gap measurement only) */
+        SET_BIT(port->instance->CR1, USART_CR1_IDLEIE);
+    }
+
+#if (DMA_ADAPT_ENABLE == 1) || (UART_DMA_STAMP == 1)
+    /* DWT cycle counter: gap measurement and arrival time */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+#if (DMA_ADAPT_ENABLE == 1)
+    UART_DMA_AdaptInit(ch);
+#endif
+
+#if (UART_ERROR_MARK == 1)
+    /* DMA Disable on Reception Error: the DMA stops at a character with parity, framing or noise error
+     * until the error flag is cleared, so that the position of the character is known (see UART_DMA_RxError()).
+     * DDRE can only be written while the UART is disabled.
+    */
+    __HAL_UART_DISABLE(&ch->huart);
+    SET_BIT(port->instance->CR3, USART_CR3_DDRE);
+    __HAL_UART_ENABLE(&ch->huart);
+#endif
+
+#if (DMA_MATCH_ENABLE == 1)
+    /* UART Character Match Configuration:
+     * CMF is set when the received character equals CR2.ADD (8-bit comparison, mute mode is not used).
+     * ADD can only be written while the UART is disabled, UART_SetConfig() keeps it on line coding changes.
+    */
+    __HAL_UART_DISABLE(&ch->huart);
+    MODIFY_REG(port->instance->CR2, USART_CR2_ADD, (uint32_t)(uint8_t)DMA_MATCH_CHAR << USART_CR2_ADD_Pos);
+    __HAL_UART_ENABLE(&ch->huart);
+    SET_BIT(port->instance->CR1, USART_CR1_CMIE);
+#endif
+    HAL_NVIC_SetPriority(port->irq, 0, 0);
+    HAL_NVIC_EnableIRQ(port->irq);
+
+    /* DMA Configuration */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    ch->hdma_rx.Instance = port->dma_rx;
+    ch->hdma_rx.Init.Request = port->dma_rx_request;
+    ch->hdma_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    ch->hdma_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    ch->hdma_rx.Init.MemInc = DMA_MINC_ENABLE;
+    ch->hdma_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    ch->hdma_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    ch->hdma_rx.Init.Mode = DMA_CIRCULAR;
+    ch->hdma_rx.Init.Priority = DMA_PRIORITY_VERY_HIGH;
+    if(HAL_DMA_Init(&ch->hdma_rx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    __HAL_LINKDMA(&ch->huart, hdmarx, ch->hdma_rx);
+    ch->event.tcFlag = __HAL_DMA_GET_TC_FLAG_INDEX(&ch->hdma_rx);
+
+    /* DMA Interrupt Configuration */
+    HAL_NVIC_SetPriority(port->dma_rx_irq, 0, 0);
+    HAL_NVIC_EnableIRQ(port->dma_rx_irq);
+
+#if (DMA_M2M_ENABLE == 1)
+    if(uart_dma_m2m.Instance == NULL)
+    {
+        UART_DMA_M2MInit();
+    }
+#endif
+
+    uart_dma_channel[id] = ch;
+}
+
+/**
+  * @brief  Start circular DMA reception
+  * @param  ch: channel object
+  * @retval None
+  */
+void UART_DMA_Start(UART_DMA_t* ch)
+{
+    if(HAL_UART_Receive_DMA(&ch->huart, ch->buf, ch->size) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+#if (DMA_HT_ENABLE == 0)
+    /* Disable Half Transfer Interrupt */
+    __HAL_DMA_DISABLE_IT(&ch->hdma_rx, DMA_IT_HT);
+#endif
+}
+
+/** DMA Rx Complete AND DMA Rx Timeout function
+ * Timeout event: generated after UART IDLE IT + DMA Timeout value (SysTick engine),
+ *                or by the UART receiver timeout IT after DMA_TIMEOUT_BITS bit-times (RTO engine)
+ * The DMA position is tracked as a free-running 32-bit write index (number of bytes received since start):
+ *  - DMA Rx Complete event: the DMA has wrapped around, the base index of the current lap is advanced by the buffer size.
+ *  - Every event: write index = base + (buffer size - CNDTR), new data is from the previous write index till
+ *    the new one, thus the length is a single subtraction for every scenario (also across the buffer end).
+ * Remarks:
+ *  - A Timeout event may be serviced while the DMA Rx Complete IT of a wrap is still pending. This wrap is already
+ *    counted by the Timeout event, and the DMA Rx Complete event that follows finds no new data.
+ *  - If there is no following data after DMA Rx Complete, the generated IDLE Timeout finds no new data, but the end of
+ *    transmission is still signalled to the consumer.
+ *  - When buffer overflow occurs, i.e. the consumer does not release data for more than a buffer length, the oldest
+ *    data is overwritten; the consumer is resynchronized by UART_DMA_Commit().
+ *  - In Half Transfer mode (DMA_HT_ENABLE), the DMA Rx Half Complete event publishes the data received so far as well,
+ *    see HAL_UART_RxHalfCpltCallback().
+ *  - The DMA interrupt has to be serviced within one buffer length of received characters.
+*/
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    UART_DMA_t* ch = UART_DMA_FROM_HANDLE(huart);
+    DMA_Event_t* ev = &ch->event;
+
+    if(ev->flag)    /* Timeout event */
+    {
+        ev->flag = 0;
+        STATS_INC(timeout_events);
+        UART_DMA_Update(ch, RX_CHUNK_FLUSH);
+    }
+    else            /* DMA Rx Complete event */
+    {
+        ev->base += ch->size;
+        STATS_INC(tc_events);
+        UART_DMA_Update(ch, 0);
+    }
+}
+
+#if (DMA_HT_ENABLE == 1)
+/** DMA Rx Half Complete function
+ * The first half of the DMA buffer is consumed on Half Transfer event while the second half is being filled,
+ * and the second half is consumed on DMA Rx Complete event. The buffer is drained twice per wrap.
+ * A Timeout event may already have processed data beyond MAX/2 before the Half Transfer IT is serviced,
+ * in this case there is no new data.
+*/
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    STATS_INC(ht_events);
+    UART_DMA_Update(UART_DMA_FROM_HANDLE(huart), 0);
+}
+#endif
+
+/** Write index of the DMA
+ * CNDTR is reloaded at the end of the buffer before the DMA Rx Complete IT is serviced, therefore the pending
+ * Transfer Complete flag is taken into account. The flag and CNDTR are read until they are consistent,
+ * i.e. no wrap occurred in between (at most twice, the flag is cleared only by the DMA interrupt).
+ * The computation is branch-free and does not depend on the buffer size.
+*/
+static uint32_t UART_DMA_WriteIndex(UART_DMA_t* ch)
+{
+    DMA_Event_t* ev = &ch->event;
+    uint32_t wrap, cndtr;
+
+    do
+    {
+        wrap = (__HAL_DMA_GET_FLAG(&ch->hdma_rx, ev->tcFlag) != 0);
+        cndtr = __HAL_DMA_GET_COUNTER(&ch->hdma_rx);
+    } while(wrap != (__HAL_DMA_GET_FLAG(&ch->hdma_rx, ev->tcFlag) != 0));
+
+    return ev->base + wrap * ch->size + ((ch->size - cndtr) & ch->rx.mask);
+}
+
+/* Publish the data received since the last event */
+static void UART_DMA_Update(UART_DMA_t* ch, uint8_t flags)
+{
+    DMA_Event_t* ev = &ch->event;
+    uint32_t wr = UART_DMA_WriteIndex(ch);
+
+#if (UART_ERROR_MARK == 1)
+    UART_DMA_Mark(ch, wr);
+#endif
+#if (UART_DMA_STAMP == 1)
+    /* Data received after the last latched stamp (e.g. DMA events): it has just arrived */
+    if(wr != ev->stampWr)
+    {
+        ev->stamp = DWT->CYCCNT;
+        ev->stampWr = wr;
+    }
+#endif
+    STATS_ADD(rx_bytes, wr - ev->wr);
+    STATS_ADD(timeout_ignored, (flags != 0) & (wr == ev->wr));
+    ev->wr = wr;
+
+    /* Publish new data to the worker, processing is deferred to PendSV */
+    UART_DMA_Publish(ch, wr, flags);
+}
+
+/** Reception errors
+ * Parity, framing and noise errors and overruns are recovered in place, the circular DMA keeps running.
+ * The error flags are cleared (the UART interrupt would be pending forever otherwise) and counted.
+ *  - A character with parity, framing or noise error is not transferred by the DMA (CR3.DDRE = 0), it is
+ *    missing from the received data.
+ *  - UART_ERROR_MARK: the DMA stops at the character instead (CR3.DDRE = 1), thus it is written to the
+ *    current write index when the flag is cleared. It is replaced by UART_ERROR_MARKER before it is published.
+ *  - Overrun: the characters received while the receive data register was full are lost and cannot be marked,
+ *    the data continues with the next character.
+ * The write index is read from the live DMA counter at every event, thus no other resynchronization is needed.
+*/
+static void UART_DMA_RxError(UART_DMA_t* ch, uint32_t isr)
+{
+    USART_TypeDef* uart = ch->huart.Instance;
+#if (UART_ERROR_MARK == 1)
+    DMA_Event_t* ev = &ch->event;
+    uint32_t wr;
+
+    if(isr & (USART_ISR_PE | USART_ISR_FE | USART_ISR_NE))
+    {
+        /* The previous marked character has been transferred before this one was received */
+        wr = UART_DMA_WriteIndex(ch);
+        UART_DMA_Mark(ch, wr);
+        ev->mark = wr;
+        ev->marked = 1;
+    }
+#endif
+
+    uart->ICR = UART_CLEAR_PEF | UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_OREF;
+
+    STATS_ADD(parity_errors, (isr & USART_ISR_PE) != 0);
+    STATS_ADD(framing_errors, (isr & USART_ISR_FE) != 0);
+    STATS_ADD(noise_errors, (isr & USART_ISR_NE) != 0);
+    STATS_ADD(overrun_errors, (isr & USART_ISR_ORE) != 0);
+}
+
+#if (UART_ERROR_MARK == 1)
+/* Replace the character received with error, once the DMA has transferred it */
+static void UART_DMA_Mark(UART_DMA_t* ch, uint32_t wr)
+{
+    DMA_Event_t* ev = &ch->event;
+
+    if(ev->marked && (int32_t)(wr - ev->mark) > 0)
+    {
+        ch->buf[ev->mark & ch->rx.mask] = UART_ERROR_MARKER;
+        ev->marked = 0;
+    }
+}
+#endif
+
+/** DMA transfer error
+ * The DMA channel of the receiver is disabled by the error and the HAL ends the reception. The reception is
+ * restarted in place:
+ *  - The data received so far is published as a Timeout event (end of transmission).
+ *  - The circular DMA restarts at the buffer beginning, i.e. at the next lap of the free-running write index.
+ *    The rest of the interrupted lap is a hole that was never received: the worker holds back the data after
+ *    it until the consumer has released the data before it, then the read position jumps over the hole (see
+ *    UART_DMA_PassHole()). Nothing is published in place of the hole.
+ *  - Up to DMA_HOLE_MAX holes are pending. A further error extends the last hole, the data received since
+ *    the previous error is dropped (the consumer is behind by more than a buffer length anyway).
+*/
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    UART_DMA_t* ch = UART_DMA_FROM_HANDLE(huart);
+    DMA_Event_t* ev = &ch->event;
+    uint32_t wr = UART_DMA_WriteIndex(ch);
+    uint32_t next = (wr + ch->rx.mask) & ~ch->rx.mask;
+
+    STATS_INC(uart_errors);
+
+#if (UART_ERROR_MARK == 1)
+    UART_DMA_Mark(ch, wr);
+    ev->marked = 0;
+#endif
+    ev->timer = 0;
+    UART_DMA_Update(ch, RX_CHUNK_FLUSH);
+
+    if(next != wr)
+    {
+        if(ev->holes < DMA_HOLE_MAX)
+        {
+            ev->hole[ev->holes].start = wr;
+            ++ev->holes;
+        }
+        ev->hole[ev->holes - 1].end = next;
+    }
+    ev->base = next;
+    ev->wr = next;
+#if (UART_DMA_STAMP == 1)
+    ev->stampWr = next;
+#endif
+
+    UART_DMA_Start(ch);
+}
+
+/** DMA Timeout duration
+ * The timeout is given in bit-times (DMA_TIMEOUT_BITS, i.e. DMA_TIMEOUT_MS at UART_BAUDRATE, or the adaptive
+ * timeout), thus it scales with the baud rate when the line coding is changed at runtime.
+ *  - RTO engine: the RTOR counts bit-times, the value does not depend on the baud rate.
+ *  - SysTick engine: the duration is converted to msec, rounded up, at least 1 msec.
+*/
+static void UART_DMA_SetTimeout(UART_DMA_t* ch, uint32_t baudrate, uint32_t bits)
+{
+    uint64_t ms;
+
+    if(ch->engine == DMA_TIMEOUT_RTO)
+    {
+        ch->timeout = bits;
+    }
+    else
+    {
+        ms = ((uint64_t)bits * 1000 + baudrate - 1) / baudrate;
+        ch->timeout = (ms == 0) ? 1 : (ms > 0xFFFF) ? 0xFFFF : (uint32_t)ms;
+    }
+}
+
+/* Character timing of the current line coding, in CPU cycles (DWT) */
+static void UART_DMA_CharTime(UART_DMA_t* ch)
+{
+    const UART_InitTypeDef* init = &ch->huart.Init;
+
+    ch->event.bitCycles = SystemCoreClock / init->BaudRate;
+    ch->event.charBits = 1 + ((init->WordLength == UART_WORDLENGTH_9B) ? 9 : (init->WordLength == UART_WORDLENGTH_7B) ? 7 : 8)
+                           + ((init->StopBits == UART_STOPBITS_1) ? 1 : 2);
+}
+
+#if (UART_DMA_STAMP == 1)
+/** Arrival time of the received data
+ * Every chunk is stamped with the DWT cycle counter at the end of its last character. The line idle events
+ * are detected some time after the last character, therefore their stamp is back-dated and latched together
+ * with the write index:
+ *  - IDLE interrupt (SysTick engine): one character time (idle frame) after the last stop bit.
+ *  - Receiver timeout interrupt (RTO engine): the DMA Timeout duration after the last stop bit.
+ * The Timeout event publishes the data with the latched stamp. Data received after the latch (DMA Rx Complete,
+ * Half Complete and character match events, data arriving while the SysTick timer runs) is stamped when it
+ * is published, see UART_DMA_Update().
+ * Remarks:
+ *  - The interrupt latency is not compensated; the DMA events are late by the DMA interrupt latency only.
+ *  - The counter wraps around every 2^32 cycles (89 sec at 48 MHz), the stamps are relative.
+*/
+static void UART_DMA_Stamp(UART_DMA_t* ch, uint32_t bits)
+{
+    DMA_Event_t* ev = &ch->event;
+
+    ev->stamp = DWT->CYCCNT - bits * ev->bitCycles;
+    ev->stampWr = UART_DMA_WriteIndex(ch);
+}
+#endif
+
+#if (DMA_ADAPT_ENABLE == 1)
+/* Restart the gap measurement with the current line coding */
+static void UART_DMA_AdaptInit(UART_DMA_t* ch)
+{
+    DMA_Adapt_t* a = &ch->adapt;
+    uint32_t i;
+
+    a->stamp = DWT->CYCCNT;
+    a->wr = ch->event.wr;
+    a->samples = 0;
+    for(i = 0; i < DMA_ADAPT_BINS; ++i)
+    {
+        a->hist[i] = 0;
+    }
+}
+
+/** Adaptive DMA Timeout
+ * The line gap before each burst is measured at the idle events: the time since the previous idle event
+ * (DWT cycle counter) minus the duration of the characters received in between. The gaps are counted in a
+ * log2 histogram of bit-times (independent of the baud rate), which is aged by halving every DMA_ADAPT_AGING
+ * gaps, so that the timeout follows a change of the traffic pattern.
+ * The timeout is placed according to the shape of the histogram:
+ *  - If the lowest cluster of gaps (adjacent occupied bins) is followed by frequent longer gaps (at least 1/8
+ *    of the gaps), the cluster is taken as pauses within the messages: the timeout is 1.5 times its upper edge,
+ *    thus the messages are not split by these pauses and they are flushed on the longer gaps between them.
+ *  - Otherwise every gap ends a message: the timeout is half of the shortest gaps, so that the messages are
+ *    flushed as early as possible.
+ * The timeout is kept between DMA_ADAPT_MIN_BITS and DMA_ADAPT_MAX_BITS and applies to the current gap.
+ * Remarks:
+ *  - The configured DMA Timeout is used until DMA_ADAPT_WARMUP gaps are measured.
+ *  - Pauses within messages as long as the gaps between them cannot be told apart; line oriented protocols
+ *    should use the flush on terminator mode (DMA_MATCH_ENABLE) instead.
+ *  - The DWT counter wraps around every 2^32 cycles (89 sec at 48 MHz), longer gaps are measured modulo
+ *    this period; a wrong sample is aged out like any other.
+*/
+static void UART_DMA_Adapt(UART_DMA_t* ch)
+{
+    DMA_Adapt_t* a = &ch->adapt;
+    uint32_t now = DWT->CYCCNT;
+    uint32_t wr = UART_DMA_WriteIndex(ch);
+    uint32_t elapsed = (now - a->stamp) / ch->event.bitCycles;
+    uint32_t burst = (wr - a->wr) * ch->event.charBits;
+    uint32_t total = 0;
+    uint32_t upper, bits, bin, i;
+
+    a->stamp = now;
+    a->wr = wr;
+
+    /* No gap before the burst (e.g. idle event delayed by a higher priority interrupt) */
+    if(elapsed <= burst)
+    {
+        return;
+    }
+
+    bin = 31 - __CLZ(elapsed - burst);
+    ++a->hist[(bin < DMA_ADAPT_BINS) ? bin : DMA_ADAPT_BINS - 1];
+    if(++a->samples == DMA_ADAPT_AGING)
+    {
+        a->samples = 0;
+        for(i = 0; i < DMA_ADAPT_BINS; ++i)
+        {
+            a->hist[i] >>= 1;
+        }
+    }
+
+    for(i = 0; i < DMA_ADAPT_BINS; ++i)
+    {
+        total += a->hist[i];
+    }
+    if(total < DMA_ADAPT_WARMUP)
+    {
+        return;
+    }
+
+    /* Lowest cluster: bins [bin, i) */
+    bin = 0;
+    while(a->hist[bin] == 0)
+    {
+        ++bin;
+    }
+    upper = total;
+    for(i = bin; i < DMA_ADAPT_BINS && a->hist[i] != 0; ++i)
+    {
+        upper -= a->hist[i];
+    }
+
+    bits = (upper * 8 >= total) ? (3UL << i) >> 1 : (1UL << bin) >> 1;
+    bits = (bits < DMA_ADAPT_MIN_BITS) ? DMA_ADAPT_MIN_BITS : (bits > DMA_ADAPT_MAX_BITS) ? DMA_ADAPT_MAX_BITS : bits;
+
+    UART_DMA_SetTimeout(ch, ch->huart.Init.BaudRate, bits);
+    if(ch->engine == DMA_TIMEOUT_RTO)
+    {
+        WRITE_REG(ch->huart.Instance->RTOR, ch->timeout & USART_RTOR_RTO);
+    }
+}
+#endif
+
+/* DMA Timeout event: set Timeout Flag and call DMA Rx Complete Callback */
+static void UART_DMA_Timeout(UART_DMA_t* ch)
+{
+    ch->event.flag = 1;
+    ch->hdma_rx.XferCpltCallback(&ch->hdma_rx);
+}
+
+#if (DMA_MATCH_ENABLE == 1)
+/** Character match flush
+ * CMF is set when the terminator is in the receive data register, together with the DMA request. The DMA
+ * (highest priority) moves it to the buffer within a few bus cycles; the handler waits for this (RXNE cleared),
+ * so that the terminator is part of the flushed data.
+ * Remarks:
+ *  - The wait is bounded: if the DMA is stalled, the terminator is flushed by the next event.
+ *  - The flush is a Timeout event, the line idle timeout that follows finds no new data.
+*/
+static void UART_DMA_Match(UART_DMA_t* ch)
+{
+    USART_TypeDef* uart = ch->huart.Instance;
+    uint32_t wait = 64;
+
+    while(((uart->ISR & USART_ISR_RXNE) != RESET) && wait)
+    {
+        --wait;
+    }
+
+    STATS_INC(match_events);
+    STATS_IDLE_EVENT(&ch->latency);
+    UART_DMA_Timeout(ch);
+}
+#endif
+
+/**
+  * @brief  UART interrupt handler, shared by all serial ports
+  * @param  id: serial port
+  * @retval None
+  */
+void UART_DMA_IRQHandler(UART_DMA_PortId_t id)
+{
+    UART_DMA_t* ch = uart_dma_channel[id];
+    USART_TypeDef* uart;
+
+    if(ch == NULL)
+    {
+        return;
+    }
+
+    STATS_ISR_ENTER();
+    uart = ch->huart.Instance;
+
+    /* UART Error Interrupt: parity, framing, noise error or overrun */
+    if((uart->ISR & (USART_ISR_PE | USART_ISR_FE | USART_ISR_NE | USART_ISR_ORE)) != RESET)
+    {
+        UART_DMA_RxError(ch, uart->ISR);
+    }
+
+#if (DMA_MATCH_ENABLE == 1)
+    /* UART Character Match Interrupt: terminator received */
+    if((uart->ISR & USART_ISR_CMF) != RESET)
+    {
+        uart->ICR = UART_CLEAR_CMF;
+        UART_DMA_Match(ch);
+    }
+#endif
+
+#if (DMA_ADAPT_ENABLE == 1)
+    /* UART IDLE Interrupt: measure the gap, adapt the timeout before it is started */
+    if((uart->ISR & USART_ISR_IDLE) != RESET && ch->engine == DMA_TIMEOUT_RTO)
+    {
+        uart->ICR = UART_CLEAR_IDLEF;
+        UART_DMA_Adapt(ch);
+    }
+#endif
+
+    if(ch->engine == DMA_TIMEOUT_RTO)
+    {
+        /* UART Receiver Timeout Interrupt */
+        if((uart->ISR & USART_ISR_RTOF) != RESET)
+        {
+            uart->ICR = UART_CLEAR_RTOF;
+            STATS_IDLE_EVENT(&ch->latency);
+#if (UART_DMA_STAMP == 1)
+            UART_DMA_Stamp(ch, ch->timeout);
+#endif
+            UART_DMA_Timeout(ch);
+        }
+    }
+    else
+    {
+        /* UART IDLE Interrupt */
+        if((uart->ISR & USART_ISR_IDLE) != RESET)
+        {
+            uart->ICR = UART_CLEAR_IDLEF;
+            STATS_IDLE_EVENT(&ch->latency);
+#if (DMA_ADAPT_ENABLE == 1)
+            UART_DMA_Adapt(ch);
+#endif
+#if (UART_DMA_STAMP == 1)
+            UART_DMA_Stamp(ch, ch->event.charBits);
+#endif
+            /* Start DMA timer */
+            ch->event.timer = (uint16_t)ch->timeout;
+        }
+    }
+
+    STATS_ISR_EXIT();
+}
+
+/**
+  * @brief  DMA interrupt handler of the receiver, shared by all serial ports
+  * @param  id: serial port
+  * @retval None
+  */
+void UART_DMA_RxIRQHandler(UART_DMA_PortId_t id)
+{
+    UART_DMA_t* ch = uart_dma_channel[id];
+    STATS_ISR_ENTER();
+
+    if(ch != NULL)
+    {
+        HAL_DMA_IRQHandler(&ch->hdma_rx);
+    }
+
+    STATS_ISR_EXIT();
+}
+
+/**
+  * @brief  DMA timer of the SysTick engine, called from SysTick_Handler every msec
+  * @param  None
+  * @retval None
+  */
+void UART_DMA_TickHandler(void)
+{
+    UART_DMA_t* ch;
+    uint8_t id;
+
+    for(id = 0; id < UART_DMA_PORT_COUNT; ++id)
+    {
+        ch = uart_dma_channel[id];
+        if(ch == NULL || ch->event.timer == 0)
+        {
+            continue;
+        }
+
+        if(ch->event.timer == 1)
+        {
+            UART_DMA_Timeout(ch);
+        }
+        --ch->event.timer;
+    }
+}
+
+/** Deferred RX processing
+ * The interrupt handlers only publish the write index of new data to the RX queue of the channel and pend
+ * the PendSV exception. PendSV has the lowest priority, therefore the worker runs after all pending interrupts
+ * are serviced and a slow consumer cannot delay the DMA, UART, SysTick or USB interrupts.
+ * Remarks:
+ *  - The DMA, UART and SysTick interrupts run at the same priority and never preempt each other,
+ *    therefore they act as a single producer of the queue.
+ *  - Descriptors are in order, each one covers the data from the previous write index. If the queue is full,
+ *    the newest descriptor is extended to the latest write index, thus no data is left unpublished until
+ *    the next event (e.g. many character match events while the worker is delayed).
+ *  - Timeout events are published with the RX_CHUNK_FLUSH flag (even without new data), so that the
+ *    consumer knows when the transmission has ended and partially collected data has to be sent out.
+*/
+static void UART_DMA_Publish(UART_DMA_t* ch, uint32_t end, uint8_t flags)
+{
+    RxChunk_t chunk;
+
+    chunk.end = end;
+    chunk.stamp = ch->event.stamp;
+    chunk.flags = ch->carry.flags | flags;
+    if(end == ch->carry.end && chunk.flags == 0)
+    {
+        return;
+    }
+
+    if(RxQueue_Push(&ch->queue, &chunk) || RxQueue_Merge(&ch->queue, &chunk))
+    {
+        ch->carry.end = end;
+        ch->carry.flags = 0;
+    }
+    else
+    {
+        ch->carry.flags = chunk.flags;
+    }
+
+    /* Trigger worker */
+    UART_DMA_Schedule();
+}
+
+/**
+  * @brief  Trigger the RX worker, e.g. when a consumer is ready to accept more data
+  * @param  None
+  * @retval None
+  */
+void UART_DMA_Schedule(void)
+{
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/**
+  * @brief  RX worker of all channels, executed from PendSV_Handler
+  * @param  None
+  * @retval None
+  */
+void UART_DMA_Process(void)
+{
+    UART_DMA_t* ch;
+    RxChunk_t chunk;
+    uint32_t end;
+    uint8_t id;
+
+    for(id = 0; id < UART_DMA_PORT_COUNT; ++id)
+    {
+        ch = uart_dma_channel[id];
+        if(ch == NULL)
+        {
+            continue;
+        }
+
+        while(RxQueue_Pop(&ch->queue, &chunk))
+        {
+#if (UART_DMA_STAMP == 1)
+            /* Chunk log of the consumer: if it is full, the newest chunk is extended */
+            if(chunk.end != ch->rx.wr && !RxQueue_Push(&ch->stamps, &chunk))
+            {
+                RxQueue_Merge(&ch->stamps, &chunk);
+            }
+#endif
+            UART_DMA_Commit(ch, chunk.end);
+            ch->flush |= chunk.flags & RX_CHUNK_FLUSH;
+        }
+
+        if(ch->read.state == UART_DMA_READ_DONE)
+        {
+            UART_DMA_ReadComplete(ch);
+        }
+
+        if((RING_COUNT(&ch->rx) || ch->flush) && ch->sink != NULL)
+        {
+            ch->sink(ch);
+        }
+
+        /* The consumer has released the data before a hole: the data after it is delivered in a new run */
+        end = ch->end;
+        if(UART_DMA_PassHole(ch, &end))
+        {
+            UART_DMA_Commit(ch, ch->end);
+            UART_DMA_Schedule();
+        }
+    }
+}
+
+/** Zero-copy consumer interface
+ * New data is not copied out of the DMA buffer. Instead, the consumer receives one or two spans
+ * pointing directly into the DMA buffer (two spans when the unreleased data wraps around the buffer end)
+ * and advances the read position explicitly with UART_DMA_Release() once the data is no longer needed.
+ * Remarks:
+ *  - The DMA keeps writing in circular mode, therefore the consumer has to release the data
+ *    before the DMA overwrites it (i.e. within one buffer length of received characters).
+ *  - If the consumer falls behind by more than a buffer length, the oldest data is lost and
+ *    the read position is resynchronized to the oldest valid byte.
+ *  - Consumers that need the data in a linear buffer use UART_DMA_Read(), which copies the unreleased data
+ *    in at most two segments with word-wide transfers (see ring.c) and releases it.
+ *  - After a DMA transfer error, the data after the hole is committed once the data before it is released.
+ *  - The consumer interface must only be used from the RX worker context.
+*/
+static void UART_DMA_Commit(UART_DMA_t* ch, uint32_t end)
+{
+    Ring_t* rx = &ch->rx;
+
+    ch->end = end;
+    UART_DMA_PassHole(ch, &end);
+    if((int32_t)(end - rx->wr) <= 0)
+    {
+        return;
+    }
+
+    rx->wr = end;
+    if(RING_COUNT(rx) > ch->size)
+    {
+        /* Consumer overrun: the entire buffer holds new data, oldest byte is at the write position */
+        rx->rd = end - ch->size;
+    }
+}
+
+/* Jump over the oldest hole once the consumer has released the data before it, and clip end to the next hole */
+static uint8_t UART_DMA_PassHole(UART_DMA_t* ch, uint32_t* end)
+{
+    Ring_t* rx = &ch->rx;
+    DMA_Event_t* ev = &ch->event;
+    uint8_t passed = 0;
+    uint8_t i;
+    uint32_t primask;
+
+    if(!ev->holes)
+    {
+        return 0;
+    }
+
+    /* Holes are added and extended by the UART interrupt */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if(rx->rd == ev->hole[0].start)
+    {
+        rx->rd = ev->hole[0].end;
+        rx->wr = ev->hole[0].end;
+        --ev->holes;
+        for(i = 0; i < ev->holes; ++i)
+        {
+            ev->hole[i] = ev->hole[i + 1];
+        }
+        passed = 1;
+    }
+    if(ev->holes && (int32_t)(*end - ev->hole[0].start) > 0)
+    {
+        *end = ev->hole[0].start;
+    }
+    __set_PRIMASK(primask);
+
+    return passed;
+}
+
+/**
+  * @brief  Get unreleased data as up to two contiguous spans
+  * @param  ch: channel object
+  * @param  span: array of two spans
+  * @retval Number of valid spans
+  */
+uint8_t UART_DMA_GetSpans(UART_DMA_t* ch, DMA_Span_t* span)
+{
+    return Ring_GetSpans(&ch->rx, span);
+}
+
+/**
+  * @brief  Release data consumed from the spans and advance the read position
+  * @param  ch: channel object
+  * @param  len: number of consumed bytes
+  * @retval None
+  */
+void UART_DMA_Release(UART_DMA_t* ch, uint32_t len)
+{
+    Ring_Release(&ch->rx, len);
+}
+
+#if (UART_DMA_STAMP == 1)
+/**
+  * @brief  Get unreleased data till the end of its chunk, with the arrival time of the chunk
+  * @param  ch: channel object
+  * @param  span: array of two spans
+  * @param  chunk: chunk of the data: end index, DWT timestamp and RX_CHUNK_xxx flags
+  * @retval Number of valid spans, 0 if there is no data
+  */
+uint8_t UART_DMA_GetStamped(UART_DMA_t* ch, DMA_Span_t* span, RxChunk_t* chunk)
+{
+    uint32_t len;
+    uint8_t n;
+
+    /* Chunks released (or overwritten, see UART_DMA_Commit()) entirely are dropped from the log */
+    while((int32_t)(ch->stamp.end - ch->rx.rd) <= 0)
+    {
+        if(!RxQueue_Pop(&ch->stamps, &ch->stamp))
+        {
+            return 0;
+        }
+    }
+    *chunk = ch->stamp;
+
+    /* Chunks are committed, the unreleased data covers the chunk */
+    n = Ring_GetSpans(&ch->rx, span);
+    len = ch->stamp.end - ch->rx.rd;
+    if(span[0].len >= len)
+    {
+        span[0].len = len;
+        return 1;
+    }
+    span[1].len = len - span[0].len;
+    return n;
+}
+#endif
+
+/**
+  * @brief  Copy unreleased data into a linear buffer and release it, for consumers that cannot use the spans
+  * @param  ch: channel object
+  * @param  dst: destination
+  * @param  len: size of the destination in bytes
+  * @retval Number of bytes copied
+  */
+uint32_t UART_DMA_Read(UART_DMA_t* ch, uint8_t* dst, uint32_t len)
+{
+    return Ring_Read(&ch->rx, dst, len);
+}
+
+/** Asynchronous read
+ * Large chunks are copied out of the DMA buffer by the memory-to-memory DMA channel (DMA_M2M_ENABLE),
+ * thus the core is free for protocol work while the data is moved:
+ *  - The read is split at the buffer end into at most two transfers, the second one is started from the
+ *    DMA interrupt of the first one.
+ *  - When the copy is complete, the RX worker releases the data and calls the done callback.
+ *  - Chunks below DMA_M2M_THRESHOLD bytes, or when the memory-to-memory channel is used by another serial
+ *    port, are copied by the CPU (UART_DMA_Read) and the done callback is called before returning.
+ * Remarks:
+ *  - One read can be in progress per channel. Until the done callback, the spans still include the data
+ *    being copied and it must not be released by the consumer.
+ *  - The memory-to-memory channel has the lowest DMA priority, the UART channels are never delayed by it.
+*/
+
+/**
+  * @brief  Copy unreleased data into a linear buffer, then release it and call done from the RX worker
+  * @param  ch: channel object
+  * @param  dst: destination
+  * @param  len: size of the destination in bytes
+  * @param  done: called with the number of bytes copied
+  * @retval HAL_OK, or HAL_BUSY if a read is already in progress on the channel
+  */
+HAL_StatusTypeDef UART_DMA_ReadAsync(UART_DMA_t* ch, uint8_t* dst, uint32_t len, UART_DMA_ReadDone_t done)
+{
+    UART_DMA_Read_t* rd = &ch->read;
+    uint32_t first;
+
+    if(rd->state != UART_DMA_READ_IDLE)
+    {
+        return HAL_BUSY;
+    }
+
+    if(len > RING_COUNT(&ch->rx))
+    {
+        len = RING_COUNT(&ch->rx);
+    }
+
+    rd->dst = dst;
+    rd->len = len;
+    rd->done = done;
+
+#if (DMA_M2M_ENABLE == 1)
+    if(len >= DMA_M2M_THRESHOLD && uart_dma_m2m_owner == NULL)
+    {
+        first = Ring_Contiguous(&ch->rx);
+        if(first > len)
+        {
+            first = len;
+        }
+        rd->second = len - first;
+        rd->state = UART_DMA_READ_BUSY;
+        uart_dma_m2m_owner = ch;
+
+        HAL_DMA_Start_IT(&uart_dma_m2m, (uint32_t)&ch->buf[ch->rx.rd & ch->rx.mask], (uint32_t)dst, first);
+        return HAL_OK;
+    }
+#endif
+
+    /* CPU copy */
+    first = Ring_Read(&ch->rx, dst, len);
+    if(done != NULL)
+    {
+        done(ch, dst, first);
+    }
+    return HAL_OK;
+}
+
+/* Asynchronous read complete: release the data and notify the consumer (RX worker context) */
+static void UART_DMA_ReadComplete(UART_DMA_t* ch)
+{
+    UART_DMA_Read_t* rd = &ch->read;
+
+    Ring_Release(&ch->rx, rd->len);
+    rd->state = UART_DMA_READ_IDLE;
+    if(rd->done != NULL)
+    {
+        rd->done(ch, rd->dst, rd->len);
+    }
+}
+
+#if (DMA_M2M_ENABLE == 1)
+/* Memory-to-memory DMA channel: DMA1 Channel 1 is not used by the serial ports */
+static void UART_DMA_M2MInit(void)
+{
+    uart_dma_m2m.Instance = DMA1_Channel1;
+    uart_dma_m2m.Init.Request = DMA_REQUEST_0;
+    uart_dma_m2m.Init.Direction = DMA_MEMORY_TO_MEMORY;
+    uart_dma_m2m.Init.PeriphInc = DMA_PINC_ENABLE;
+    uart_dma_m2m.Init.MemInc = DMA_MINC_ENABLE;
+    uart_dma_m2m.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    uart_dma_m2m.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    uart_dma_m2m.Init.Mode = DMA_NORMAL;
+    uart_dma_m2m.Init.Priority = DMA_PRIORITY_LOW;
+    if(HAL_DMA_Init(&uart_dma_m2m) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    uart_dma_m2m.XferCpltCallback = UART_DMA_M2MCplt;
+    uart_dma_m2m.XferHalfCpltCallback = NULL;
+
+    HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+}
+
+/* Memory-to-memory DMA complete: start the second segment, or hand the read over to the RX worker */
+static void UART_DMA_M2MCplt(DMA_HandleTypeDef* hdma)
+{
+    UART_DMA_t* ch = uart_dma_m2m_owner;
+    UART_DMA_Read_t* rd = &ch->read;
+    uint32_t second = rd->second;
+
+    if(second)
+    {
+        rd->second = 0;
+        HAL_DMA_Start_IT(hdma, (uint32_t)&ch->buf[0], (uint32_t)&rd->dst[rd->len - second], second);
+        return;
+    }
+
+    uart_dma_m2m_owner = NULL;
+    rd->state = UART_DMA_READ_DONE;
+    UART_DMA_Schedule();
+}
+
+/**
+  * @brief  DMA interrupt handler of the memory-to-memory transfers
+  * @param  None
+  * @retval None
+  */
+void UART_DMA_M2MIRQHandler(void)
+{
+    STATS_ISR_ENTER();
+    HAL_DMA_IRQHandler(&uart_dma_m2m);
+    STATS_ISR_EXIT();
+}
+#endif
+
+/** DMA driven transmitter
+ * The producer copies data into the TX ring with UART_DMA_Write(), the DMA transmits the ring content
+ * in contiguous segments (one segment till the ring end, then one from the beginning).
+ * The next segment is started directly from the DMA transfer complete interrupt, the DMAT bit of the UART
+ * is kept set, thus there is no gap between the segments and the line runs at the configured baud rate.
+ * When a segment is complete, the producer is notified that space has been freed in the ring
+ * (e.g. to accept the next USB OUT packet).
+*/
+
+/**
+  * @brief  Initialize the DMA driven transmitter of a serial port
+  * @param  ch: channel object, initialized with UART_DMA_Init()
+  * @param  buf: TX ring buffer
+  * @param  size: TX ring size in bytes, power of two
+  * @param  notify: called from the DMA interrupt when space is freed in the TX ring, can be NULL
+  * @retval None
+  */
+void UART_DMA_InitTx(UART_DMA_t* ch, uint8_t* buf, uint16_t size, UART_DMA_TxNotify_t notify)
+{
+    const UART_DMA_Port_t* port = ch->port;
+
+    if(!RING_IS_POW2(size))
+    {
+        Error_Handler();
+    }
+
+    Ring_Init(&ch->tx.ring, buf, size);
+    ch->tx.xfer = 0;
+    ch->tx.notify = notify;
+
+    /* DMA Configuration */
+    ch->hdma_tx.Instance = port->dma_tx;
+    ch->hdma_tx.Init.Request = port->dma_tx_request;
+    ch->hdma_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    ch->hdma_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    ch->hdma_tx.Init.MemInc = DMA_MINC_ENABLE;
+    ch->hdma_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    ch->hdma_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    ch->hdma_tx.Init.Mode = DMA_NORMAL;
+    ch->hdma_tx.Init.Priority = DMA_PRIORITY_HIGH;
+    if(HAL_DMA_Init(&ch->hdma_tx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    __HAL_LINKDMA(&ch->huart, hdmatx, ch->hdma_tx);
+    ch->hdma_tx.XferCpltCallback = UART_DMA_TxCplt;
+    ch->hdma_tx.XferHalfCpltCallback = NULL;
+
+    /* DMA Interrupt Configuration */
+    HAL_NVIC_SetPriority(port->dma_tx_irq, 0, 0);
+    HAL_NVIC_EnableIRQ(port->dma_tx_irq);
+
+    /* UART transmitter is fed by the DMA */
+    SET_BIT(port->instance->CR3, USART_CR3_DMAT);
+}
+
+/**
+  * @brief  Copy data into the TX ring and start transmission
+  * @param  ch: channel object
+  * @param  data: data to be sent
+  * @param  len: number of bytes
+  * @retval Number of bytes written, less than len if the ring is full
+  */
+uint16_t UART_DMA_Write(UART_DMA_t* ch, const uint8_t* data, uint16_t len)
+{
+    UART_DMA_Tx_t* tx = &ch->tx;
+    uint32_t primask;
+
+    /* The ring is shared with the DMA interrupt */
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    len = (uint16_t)Ring_Write(&tx->ring, data, len);
+
+    /* Transmitter is idle: start DMA */
+    if(tx->xfer == 0)
+    {
+        UART_DMA_TxStart(ch);
+    }
+
+    __set_PRIMASK(primask);
+    return len;
+}
+
+/**
+  * @brief  Get free space in the TX ring
+  * @param  ch: channel object
+  * @retval Number of bytes that can be written
+  */
+uint16_t UART_DMA_TxFree(UART_DMA_t* ch)
+{
+    return (uint16_t)RING_FREE(&ch->tx.ring);
+}
+
+/* Start DMA transfer of the next contiguous segment of the TX ring */
+static void UART_DMA_TxStart(UART_DMA_t* ch)
+{
+    UART_DMA_Tx_t* tx = &ch->tx;
+    uint16_t len = (uint16_t)Ring_Contiguous(&tx->ring);
+
+    tx->xfer = len;
+    if(len)
+    {
+        HAL_DMA_Start_IT(&ch->hdma_tx, (uint32_t)&tx->ring.buf[tx->ring.rd & tx->ring.mask], (uint32_t)&ch->huart.Instance->TDR, len);
+    }
+}
+
+/* DMA Tx Complete: free the transmitted segment, start the next one and notify the producer */
+static void UART_DMA_TxCplt(DMA_HandleTypeDef* hdma)
+{
+    UART_DMA_t* ch = UART_DMA_FROM_HANDLE(hdma->Parent);
+    UART_DMA_Tx_t* tx = &ch->tx;
+
+    Ring_Release(&tx->ring, tx->xfer);
+
+    UART_DMA_TxStart(ch);
+
+    if(tx->notify != NULL)
+    {
+        tx->notify(ch);
+    }
+}
+
+/**
+  * @brief  DMA interrupt handler of the transmitter, shared by all serial ports
+  * @param  id: serial port
+  * @retval None
+  */
+void UART_DMA_TxIRQHandler(UART_DMA_PortId_t id)
+{
+    UART_DMA_t* ch = uart_dma_channel[id];
+    STATS_ISR_ENTER();
+
+    if(ch != NULL)
+    {
+        HAL_DMA_IRQHandler(&ch->hdma_tx);
+    }
+
+    STATS_ISR_EXIT();
+}
+
+/** Runtime line coding change
+ * The UART is reprogrammed without stopping the DMA channels, thus the content and the positions of the
+ * DMA buffer and the TX ring are preserved and no buffered data is lost:
+ *  (1): The TX DMA requests are paused (DMAT cleared) and the character in progress is let out (TC).
+ *  (2): Data received so far is flushed to the consumer as a timeout event.
+ *  (3): The UART is disabled (UE cleared), the baud rate, word length, stop bits and parity are set,
+ *       and the DMA Timeout duration is recomputed from the new bit time.
+ *  (4): The UART is enabled and the TX DMA requests are resumed, the DMA continues where it was paused.
+ * Remarks:
+ *  - Must be called from an interrupt at the priority of the UART and DMA interrupts (e.g. USB interrupt),
+ *    after UART_DMA_Init().
+ *  - A character being received while the UART is disabled is lost, the host changes the line coding
+ *    when the line is idle.
+ *  - If the new configuration cannot be applied (e.g. baud rate out of range), the previous one is restored.
+*/
+HAL_StatusTypeDef UART_DMA_SetLineCoding(UART_DMA_t* ch, uint32_t baudrate, uint32_t wordlength, uint32_t stopbits, uint32_t parity)
+{
+    USART_TypeDef* uart = ch->huart.Instance;
+    UART_InitTypeDef prev = ch->huart.Init;
+    uint32_t dmat = READ_BIT(uart->CR3, USART_CR3_DMAT);
+    uint32_t wait;
+    HAL_StatusTypeDef status;
+
+    /* Channel is not initialized yet */
+    if(ch->huart.gState == HAL_UART_STATE_RESET)
+    {
+        return HAL_ERROR;
+    }
+
+    /* (1): Pause TX DMA, wait for the last characters (at most two character times at previous baud rate) */
+    CLEAR_BIT(uart->CR3, USART_CR3_DMAT);
+    wait = (SystemCoreClock / prev.BaudRate) * 24;
+    while(((uart->ISR & USART_ISR_TC) == RESET) && wait)
+    {
+        --wait;
+    }
+
+    /* (2): Flush received data (if reception is started) */
+    if(ch->hdma_rx.XferCpltCallback != NULL)
+    {
+        ch->event.timer = 0;
+        UART_DMA_Timeout(ch);
+    }
+
+    /* (3): Reconfigure UART */
+    __HAL_UART_DISABLE(&ch->huart);
+    ch->huart.Init.BaudRate = baudrate;
+    ch->huart.Init.WordLength = wordlength;
+    ch->huart.Init.StopBits = stopbits;
+    ch->huart.Init.Parity = parity;
+    status = UART_SetConfig(&ch->huart);
+    if(status != HAL_OK)
+    {
+        ch->huart.Init = prev;
+        UART_SetConfig(&ch->huart);
+    }
+    UART_DMA_SetTimeout(ch, ch->huart.Init.BaudRate, DMA_TIMEOUT_BITS);
+    UART_DMA_CharTime(ch);
+#if (DMA_ADAPT_ENABLE == 1)
+    UART_DMA_AdaptInit(ch);
+#endif
+    if(ch->engine == DMA_TIMEOUT_RTO)
+    {
+        WRITE_REG(uart->RTOR, ch->timeout & USART_RTOR_RTO);
+    }
+
+    /* (4): Resume */
+    __HAL_UART_ENABLE(&ch->huart);
+    SET_BIT(uart->CR3, dmat);
+
+    return status;
+}
@@ -7,6 +7,8 @@
   * @brief  USB CDC VCP
   *	        This file contains the USB CDC VCP (Virtual COM Port)
   *         implementation using the STM32Cube USB Device Library.
+  *         Every CDC function (port) of the composite device has its own
+  *         OUT buffer, IN transfer queue and line coding.
   * @see    www.st.com/resource/en/user_manual/dm00108129.pdf
   ******************************************************************************
   * Copyright (c) 2017 Akos Pasztor.                    https://akospasztor.com
@@ -14,15 +16,25 @@
 **/
 
 /* Includes ------------------------------------------------------------------*/
+#include "main.h"
 #include "usbd_cdc_if.h"
+#include "stats.h"
 
 /* Defines -------------------------------------------------------------------*/
 #define APP_RX_DATA_SIZE  64
 #define APP_TX_DATA_SIZE  64
 
 /* Private variables ---------------------------------------------------------*/
-uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
+uint8_t UserRxBufferFS[USBD_CDC_PORTS][APP_RX_DATA_SIZE];
 uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
+CDC_TxQueue_t TxQueueFS[USBD_CDC_PORTS + USBD_CDC_BULK];   /* Queued IN transfers of the ports and the bulk interface */
+USBD_CDC_LineCodingTypeDef LineCodingFS[USBD_CDC_PORTS] =   /* Line coding in effect: 8N1 */
+{
+    { UART_BAUDRATE, 0, 0, 8 },
+#if (USBD_CDC_PORTS > 1)
+    { UART_BAUDRATE, 0, 0, 8 },
+#endif
+};
 
 /* External variables --------------------------------------------------------*/
 extern USBD_HandleTypeDef hUsbDeviceFS;
@@ -30,15 +42,21 @@ extern USBD_HandleTypeDef hUsbDeviceFS;
 /* Private function prototypes -----------------------------------------------*/
 static int8_t CDC_Init_FS(void);
 static int8_t CDC_DeInit_FS(void);
-static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length);
-static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
+static int8_t CDC_Control_FS(uint8_t port, uint8_t cmd, uint8_t* pbuf, uint16_t length);
+static int8_t CDC_Receive_FS(uint8_t port, uint8_t* pbuf, uint32_t *Len);
+static int8_t CDC_TransmitCplt_FS(uint8_t port, uint8_t* pbuf, uint32_t *Len, uint8_t epnum);
+static uint8_t CDC_TxQueue_FS(uint8_t port, uint8_t* Buf, uint16_t Len, uint8_t zlp);
+static void CDC_TxStart_FS(uint8_t port);
+static void CDC_TxFlush_FS(uint8_t port);
+static void CDC_TxNotify_FS(uint8_t port, uint8_t* Buf, uint32_t Len);
 
 USBD_CDC_ItfTypeDef USBD_Interface_fops_FS = 
 {
     CDC_Init_FS,
     CDC_DeInit_FS,
     CDC_Control_FS,  
-    CDC_Receive_FS
+    CDC_Receive_FS,
+    CDC_TransmitCplt_FS
 };
 
 /**
@@ -49,9 +67,19 @@ USBD_CDC_ItfTypeDef USBD_Interface_fops_FS =
   */
 static int8_t CDC_Init_FS(void)
 { 
+    uint8_t port;
+
     /* Set Application Buffers */
-    USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
-    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+    for(port = 0; port < USBD_CDC_PORTS; ++port)
+    {
+        USBD_CDC_SetTxBuffer(&hUsbDeviceFS, port, UserTxBufferFS, 0);
+        USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, UserRxBufferFS[port]);
+    }
+    for(port = 0; port < USBD_CDC_PORTS + USBD_CDC_BULK; ++port)
+    {
+        TxQueueFS[port].head = 0;
+        TxQueueFS[port].tail = 0;
+    }
     return (USBD_OK);
 }
 
@@ -63,25 +91,35 @@ static int8_t CDC_Init_FS(void)
   */
 static int8_t CDC_DeInit_FS(void)
 {  
+    uint8_t port;
+
+    /* Queued transfers are aborted */
+    for(port = 0; port < USBD_CDC_PORTS + USBD_CDC_BULK; ++port)
+    {
+        CDC_TxFlush_FS(port);
+    }
     return (USBD_OK);
 }
 
 /**
   * @brief  CDC_Control_FS
   *         Manage the CDC class requests
+  * @param  port: CDC function addressed by the request
   * @param  cmd: Command code            
   * @param  pbuf: Buffer containing command data (request parameters)
   * @param  length: Number of data to be sent (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_Control_FS  (uint8_t cmd, uint8_t* pbuf, uint16_t length)
+static int8_t CDC_Control_FS  (uint8_t port, uint8_t cmd, uint8_t* pbuf, uint16_t length)
 { 
     switch (cmd)
     {
         case CDC_SEND_ENCAPSULATED_COMMAND:
+            CDC_CommandCallback(pbuf, length);
         break;
 
         case CDC_GET_ENCAPSULATED_RESPONSE:
+            CDC_ResponseCallback(pbuf, length);
         break;
 
         case CDC_SET_COMM_FEATURE:
@@ -111,9 +149,30 @@ static int8_t CDC_Control_FS  (uint8_t cmd, uint8_t* pbuf, uint16_t length)
         /* 6      | bDataBits  |   1   | Number Data bits (5, 6, 7, 8 or 16).          */
         /*******************************************************************************/
         case CDC_SET_LINE_CODING:   
+        {
+            USBD_CDC_LineCodingTypeDef coding;
+            
+            coding.bitrate = (uint32_t)pbuf[0] | ((uint32_t)pbuf[1] << 8) | ((uint32_t)pbuf[2] << 16) | ((uint32_t)pbuf[3] << 24);
+            coding.format = pbuf[4];
+            coding.paritytype = pbuf[5];
+            coding.datatype = pbuf[6];
+            
+            /* Line coding rejected by the user is not stored, the host reads back the one in effect */
+            if(CDC_LineCodingCallback(port, &coding) == USBD_OK)
+            {
+                LineCodingFS[port] = coding;
+            }
+        }
         break;
 
         case CDC_GET_LINE_CODING:     
+            pbuf[0] = (uint8_t)(LineCodingFS[port].bitrate);
+            pbuf[1] = (uint8_t)(LineCodingFS[port].bitrate >> 8);
+            pbuf[2] = (uint8_t)(LineCodingFS[port].bitrate >> 16);
+            pbuf[3] = (uint8_t)(LineCodingFS[port].bitrate >> 24);
+            pbuf[4] = LineCodingFS[port].format;
+            pbuf[5] = LineCodingFS[port].paritytype;
+            pbuf[6] = LineCodingFS[port].datatype;
         break;
 
         case CDC_SET_CONTROL_LINE_STATE:
@@ -139,39 +198,327 @@ static int8_t CDC_Control_FS  (uint8_t cmd, uint8_t* pbuf, uint16_t length)
   *         is complete on CDC interface (ie. using DMA controller) it will result 
   *         in receiving more data while previous ones are still not sent.
   *                 
+  * @param  port: CDC function
   * @param  Buf: Buffer of data to be received
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t CDC_Receive_FS (uint8_t* Buf, uint32_t *Len)
+static int8_t CDC_Receive_FS (uint8_t port, uint8_t* Buf, uint32_t *Len)
 {
-    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+    /* The endpoint is re-armed only when the user is ready for the next packet, the host is NAKed until then */
+    if(CDC_RxCallback(port, Buf, *Len) == USBD_OK)
+    {
+        CDC_ReceiveNext_FS(port);
+    }
     return (USBD_OK);
 }
 
+/**
+  * @brief  CDC_ReceiveNext_FS
+  *         Re-arm the OUT endpoint to accept the next packet. Used to resume
+  *         reception after CDC_RxCallback() returned USBD_BUSY.
+  * @param  port: CDC function
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+uint8_t CDC_ReceiveNext_FS(uint8_t port)
+{
+    if(hUsbDeviceFS.pClassData == NULL)
+    {
+        return USBD_FAIL;
+    }
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, port, UserRxBufferFS[port]);
+    return USBD_CDC_ReceivePacket(&hUsbDeviceFS, port);
+}
+
 /**
   * @brief  CDC_Transmit_FS
   *         Data send over USB IN endpoint are sent over CDC interface 
   *         through this function.           
   *         @note
-  *         
+  *         The buffer is not copied, it is queued for transmission and must
+  *         be kept valid until CDC_TxCpltCallback() is called with it.
+  *         Up to CDC_TX_QUEUE_SIZE transfers can be queued. The next queued
+  *         transfer is started from the USB interrupt when the previous one
+  *         is complete, thus the IN endpoint is kept busy continuously.
+  *         Every port has its own queue and IN endpoint.
   *                 
+  * @param  port: CDC function
+  * @param  Buf: Buffer of data to be send
+  * @param  Len: Number of data to be send (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  */
+uint8_t CDC_Transmit_FS(uint8_t port, uint8_t* Buf, uint16_t Len)
+{
+    /* Every transfer ends the host read */
+    return CDC_TxQueue_FS(port, Buf, Len, 1);
+}
+
+/**
+  * @brief  CDC_TransmitBulk_FS
+  *         Queue a transfer on the bulk IN endpoint of the vendor-specific
+  *         interface, like CDC_Transmit_FS(). The completion is signalled
+  *         with CDC_BulkTxCpltCallback().
+  *         @note
+  *         A transfer of packet size multiple length is terminated with a
+  *         ZLP only if zlp is set. Otherwise the host read continues with the
+  *         next transfer, thus a continuous stream is sent in full packets
+  *         only. A zero length transfer with zlp set sends a single ZLP.
+  *
   * @param  Buf: Buffer of data to be send
   * @param  Len: Number of data to be send (in bytes)
+  * @param  zlp: 1 if the transfer ends the data, 0 if the stream continues
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
   */
-uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
+uint8_t CDC_TransmitBulk_FS(uint8_t* Buf, uint16_t Len, uint8_t zlp)
 {
+#if (USBD_CDC_BULK == 1)
+    return CDC_TxQueue_FS(CDC_BULK_PORT, Buf, Len, zlp);
+#else
+    return USBD_FAIL;
+#endif
+}
+
+/**
+  * @brief  CDC_TxQueue_FS
+  *         Queue an IN transfer, start it if the endpoint is idle
+  * @param  port: CDC function or CDC_BULK_PORT
+  * @param  Buf: Buffer of data to be send
+  * @param  Len: Number of data to be send (in bytes)
+  * @param  zlp: terminate the transfer with a ZLP if packet size multiple
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  */
+static uint8_t CDC_TxQueue_FS(uint8_t port, uint8_t* Buf, uint16_t Len, uint8_t zlp)
+{
+    CDC_TxQueue_t* q = &TxQueueFS[port];
     uint8_t result = USBD_OK;
+    uint32_t primask;
+
+    if(hUsbDeviceFS.pClassData == NULL)
+    {
+        return USBD_FAIL;
+    }
 
-    USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-    if(hcdc->TxState != 0)
+    /* The queue is shared with the USB interrupt */
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if((q->tail - q->head) == CDC_TX_QUEUE_SIZE)
+    {
+        STATS_INC(usb_busy);
+        result = USBD_BUSY;
+    }
+    else
     {
-        return USBD_BUSY;
+        q->item[q->tail & (CDC_TX_QUEUE_SIZE - 1)].buf = Buf;
+        q->item[q->tail & (CDC_TX_QUEUE_SIZE - 1)].len = Len;
+        q->item[q->tail & (CDC_TX_QUEUE_SIZE - 1)].zlp = zlp;
+        ++q->tail;
+        STATS_ADD(usb_bytes, Len);
+
+        /* Endpoint is idle: start transfer */
+        if((q->tail - q->head) == 1)
+        {
+            CDC_TxStart_FS(port);
+        }
     }
-    USBD_CDC_SetTxBuffer(&hUsbDeviceFS, Buf, Len);
-    result = USBD_CDC_TransmitPacket(&hUsbDeviceFS);
 
+    __set_PRIMASK(primask);
     return result;
 }
+
+/**
+  * @brief  CDC_TxStart_FS
+  *         Start the IN transfer at the head of the queue
+  * @param  port: CDC function or CDC_BULK_PORT
+  * @retval None
+  */
+static void CDC_TxStart_FS(uint8_t port)
+{
+    CDC_TxItem_t* item = &TxQueueFS[port].item[TxQueueFS[port].head & (CDC_TX_QUEUE_SIZE - 1)];
+
+    USBD_CDC_SetTxBuffer(&hUsbDeviceFS, port, item->buf, item->len);
+    USBD_CDC_SetTxZlp(&hUsbDeviceFS, port, item->zlp);
+    USBD_CDC_TransmitPacket(&hUsbDeviceFS, port);
+}
+
+/**
+  * @brief  CDC_TxFlush_FS
+  *         Drop the queued transfers, e.g. on disconnect. The buffers are
+  *         returned to the user with CDC_TxCpltCallback().
+  * @param  port: CDC function or CDC_BULK_PORT
+  * @retval None
+  */
+static void CDC_TxFlush_FS(uint8_t port)
+{
+    CDC_TxQueue_t* q = &TxQueueFS[port];
+    CDC_TxItem_t item;
+
+    while(q->head != q->tail)
+    {
+        item = q->item[q->head & (CDC_TX_QUEUE_SIZE - 1)];
+        ++q->head;
+        CDC_TxNotify_FS(port, item.buf, item.len);
+    }
+}
+
+/**
+  * @brief  CDC_TxNotify_FS
+  *         Return a sent (or dropped) buffer to the user of the port
+  * @param  port: CDC function or CDC_BULK_PORT
+  * @param  Buf: Buffer of data that has been sent
+  * @param  Len: Number of data sent (in bytes)
+  * @retval None
+  */
+static void CDC_TxNotify_FS(uint8_t port, uint8_t* Buf, uint32_t Len)
+{
+#if (USBD_CDC_BULK == 1)
+    if(port == CDC_BULK_PORT)
+    {
+        CDC_BulkTxCpltCallback(Buf, Len);
+        return;
+    }
+#endif
+    CDC_TxCpltCallback(port, Buf, Len);
+}
+
+/**
+  * @brief  CDC_TransmitCplt_FS
+  *         Data transmitted callback, called from the USB interrupt when the
+  *         IN transfer at the head of the queue is complete. The next queued
+  *         transfer is started before the user is notified.
+  *         
+  * @param  port: CDC function or CDC_BULK_PORT
+  * @param  Buf: Buffer of data that has been sent
+  * @param  Len: Number of data sent (in bytes)
+  * @param  epnum: Endpoint number
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_TransmitCplt_FS(uint8_t port, uint8_t* Buf, uint32_t *Len, uint8_t epnum)
+{
+    CDC_TxQueue_t* q = &TxQueueFS[port];
+    CDC_TxItem_t item;
+
+    if(q->head == q->tail)
+    {
+        return (USBD_FAIL);
+    }
+
+    item = q->item[q->head & (CDC_TX_QUEUE_SIZE - 1)];
+    ++q->head;
+
+    /* Chain the next transfer */
+    if(q->head != q->tail)
+    {
+        CDC_TxStart_FS(port);
+    }
+
+    CDC_TxNotify_FS(port, item.buf, item.len);
+    return (USBD_OK);
+}
+
+/**
+  * @brief  CDC_TxCpltCallback
+  *         Transmit complete callback, the transmitted buffer can be reused.
+  *         @note
+  *         This function should not be modified, when the callback is needed,
+  *         the CDC_TxCpltCallback could be implemented in the user file.
+  *         
+  * @param  port: CDC function
+  * @param  Buf: Buffer of data that has been sent
+  * @param  Len: Number of data sent (in bytes)
+  * @retval None
+  */
+__weak void CDC_TxCpltCallback(uint8_t port, uint8_t* Buf, uint32_t Len)
+{
+    
+}
+
+/**
+  * @brief  CDC_BulkTxCpltCallback
+  *         Transmit complete callback of the bulk IN endpoint, the transmitted
+  *         buffer can be reused.
+  *         @note
+  *         This function should not be modified, when the callback is needed,
+  *         the CDC_BulkTxCpltCallback could be implemented in the user file.
+  *         
+  * @param  Buf: Buffer of data that has been sent
+  * @param  Len: Number of data sent (in bytes)
+  * @retval None
+  */
+__weak void CDC_BulkTxCpltCallback(uint8_t* Buf, uint32_t Len)
+{
+    
+}
+
+/**
+  * @brief  CDC_RxCallback
+  *         Data received callback, called from the USB interrupt with the
+  *         packet received on the OUT endpoint.
+  *         @note
+  *         This function should not be modified, when the callback is needed,
+  *         the CDC_RxCallback could be implemented in the user file.
+  *         
+  * @param  port: CDC function
+  * @param  Buf: Buffer of data received
+  * @param  Len: Number of data received (in bytes)
+  * @retval USBD_OK to accept the next packet immediately, USBD_BUSY to hold
+  *         the host until CDC_ReceiveNext_FS() is called
+  */
+__weak uint8_t CDC_RxCallback(uint8_t port, uint8_t* Buf, uint32_t Len)
+{
+    return (USBD_OK);
+}
+
+/**
+  * @brief  CDC_LineCodingCallback
+  *         Line coding requested by the host (CDC_SET_LINE_CODING), called
+  *         from the USB interrupt.
+  *         @note
+  *         This function should not be modified, when the callback is needed,
+  *         the CDC_LineCodingCallback could be implemented in the user file.
+  *         
+  * @param  port: CDC function
+  * @param  coding: requested line coding
+  * @retval USBD_OK if the line coding is applied, USBD_FAIL if not supported
+  */
+__weak uint8_t CDC_LineCodingCallback(uint8_t port, USBD_CDC_LineCodingTypeDef* coding)
+{
+    return (USBD_OK);
+}
+
+/**
+  * @brief  CDC_CommandCallback
+  *         Encapsulated command received from the host
+  *         (CDC_SEND_ENCAPSULATED_COMMAND), called from the USB interrupt.
+  *         @note
+  *         This function should not be modified, when the callback is needed,
+  *         the CDC_CommandCallback could be implemented in the user file.
+  *         
+  * @param  Buf: command data
+  * @param  Len: number of command bytes
+  * @retval None
+  */
+__weak void CDC_CommandCallback(uint8_t* Buf, uint16_t Len)
+{
+    
+}
+
+/**
+  * @brief  CDC_ResponseCallback
+  *         Encapsulated response requested by the host
+  *         (CDC_GET_ENCAPSULATED_RESPONSE), called from the USB interrupt.
+  *         @note
+  *         This function should not be modified, when the callback is needed,
+  *         the CDC_ResponseCallback could be implemented in the user file.
+  *         
+  * @param  Buf: response buffer to be filled
+  * @param  Len: number of bytes requested by the host
+  * @retval None
+  */
+__weak void CDC_ResponseCallback(uint8_t* Buf, uint16_t Len)
+{
+    while(Len--)
+    {
+        *Buf++ = 0;
+    }
+}
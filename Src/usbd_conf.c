@@ -48,9 +48,71 @@
 #include "usbd_cdc.h"
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* OTG FS FIFO planner
+ * The FIFO RAM is partitioned at build time from the endpoint table of the configuration, in 32-bit words:
+ *  - RX FIFO (shared by all OUT endpoints): SETUP packets (5 words per control endpoint + 8), two largest
+ *    OUT packets with their status words (back-to-back OUT packets), 2 words per OUT endpoint for the
+ *    transfer complete status, and 1 word for the global OUT NAK,
+ *  - TX FIFO of EP0 and the CDC command endpoints: one packet, at least the minimum depth of 16 words,
+ *  - TX FIFO of the data IN endpoints: two packets (double buffered),
+ *  - TX FIFO of the streaming endpoint (the bulk interface, or the data IN endpoint of USART2): all the
+ *    rest in whole packets, so the core holds as many packets ahead of the host polls as possible.
+ * The words left over by the rounding go to the RX FIFO. The TX FIFOs follow the endpoint numbering:
+ * EP(2n+1) data IN and EP(2n+2) command IN of port n, then the bulk IN endpoint.
+ */
+#define FIFO_RAM_WORDS          320U    /* 1.25 KB FIFO RAM of the OTG FS core */
+#define FIFO_TX_MIN_WORDS       16U     /* Minimum TX FIFO depth */
+#define FIFO_DEV_ENDPOINTS      6U      /* Endpoints of the OTG FS core (EP0..EP5) */
+#define FIFO_WORDS(mps)         (((mps) + 3U) / 4U)
+#define FIFO_PKT_WORDS          FIFO_WORDS(CDC_DATA_FS_MAX_PACKET_SIZE)
+#define FIFO_ONE_PKT(mps)       ((FIFO_WORDS(mps) < FIFO_TX_MIN_WORDS) ? FIFO_TX_MIN_WORDS : FIFO_WORDS(mps))
+
+#define FIFO_IN_ENDPOINTS       (1U + 2U * USBD_CDC_PORTS + USBD_CDC_BULK)
+#define FIFO_OUT_ENDPOINTS      (1U + USBD_CDC_PORTS)
+#define FIFO_DATA_IN_ENDPOINTS  (USBD_CDC_PORTS + USBD_CDC_BULK)
+
+#define FIFO_RX_MIN_WORDS       ((5U * 1U + 8U) + 2U * (FIFO_PKT_WORDS + 1U) + 2U * FIFO_OUT_ENDPOINTS + 1U)
+#define FIFO_EP0_WORDS          FIFO_ONE_PKT(USB_MAX_EP0_SIZE)
+#define FIFO_CMD_WORDS          FIFO_ONE_PKT(CDC_CMD_PACKET_SIZE)
+#define FIFO_DATA_WORDS         (2U * FIFO_PKT_WORDS)
+#define FIFO_FIXED_WORDS        (FIFO_RX_MIN_WORDS + FIFO_EP0_WORDS + USBD_CDC_PORTS * FIFO_CMD_WORDS + \
+                                 (FIFO_DATA_IN_ENDPOINTS - 1U) * FIFO_DATA_WORDS)
+#define FIFO_STREAM_WORDS       (((FIFO_RAM_WORDS - FIFO_FIXED_WORDS) / FIFO_PKT_WORDS) * FIFO_PKT_WORDS)
+#define FIFO_RX_WORDS           (FIFO_RAM_WORDS - FIFO_FIXED_WORDS - FIFO_STREAM_WORDS + FIFO_RX_MIN_WORDS)
+
+/* TX FIFO of the data IN endpoint of port n */
+#if (USBD_CDC_BULK == 1)
+#define FIFO_DATA_IN_WORDS(n)   FIFO_DATA_WORDS
+#else
+#define FIFO_DATA_IN_WORDS(n)   (((n) == 0U) ? FIFO_STREAM_WORDS : FIFO_DATA_WORDS)
+#endif
+
+#if (FIFO_IN_ENDPOINTS > FIFO_DEV_ENDPOINTS) || (FIFO_OUT_ENDPOINTS > FIFO_DEV_ENDPOINTS)
+#error "The endpoint table does not fit into the endpoints of the OTG FS core"
+#endif
+
+#if (FIFO_FIXED_WORDS + 2U * FIFO_PKT_WORDS > FIFO_RAM_WORDS)
+#error "The endpoint table does not fit into the OTG FS FIFO RAM with a double buffered streaming endpoint"
+#endif
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 PCD_HandleTypeDef hpcd_USB_OTG_FS;
+
+/* TX FIFO depth of the IN endpoints in words, in endpoint number order (see the FIFO planner) */
+static const uint16_t fifo_tx_words[FIFO_IN_ENDPOINTS] =
+{
+  FIFO_EP0_WORDS,
+  FIFO_DATA_IN_WORDS(0U),
+  FIFO_CMD_WORDS,
+#if (USBD_CDC_PORTS > 1)
+  FIFO_DATA_IN_WORDS(1U),
+  FIFO_CMD_WORDS,
+#endif
+#if (USBD_CDC_BULK == 1)
+  FIFO_STREAM_WORDS,
+#endif
+};
 void Error_Handler(void);
 
 /* Exported function prototypes -----------------------------------------------*/
@@ -286,6 +348,8 @@ void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd)
   */
 USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev)
 { 
+  uint8_t ep;
+  
   /* Init USB_IP */
   if (pdev->id == DEVICE_FS) {
   /* enable USB power on Pwrctrl CR2 register */
@@ -294,7 +358,7 @@ USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev)
   pdev->pData = &hpcd_USB_OTG_FS;
   
   hpcd_USB_OTG_FS.Instance = USB_OTG_FS;
-  hpcd_USB_OTG_FS.Init.dev_endpoints = 6;
+  hpcd_USB_OTG_FS.Init.dev_endpoints = FIFO_DEV_ENDPOINTS;
   hpcd_USB_OTG_FS.Init.speed = PCD_SPEED_FULL;
   hpcd_USB_OTG_FS.Init.ep0_mps = DEP0CTL_MPS_64;
   hpcd_USB_OTG_FS.Init.phy_itface = PCD_PHY_EMBEDDED;
@@ -308,9 +372,12 @@ USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev)
     Error_Handler();
   }
 
-  HAL_PCDEx_SetRxFiFo(&hpcd_USB_OTG_FS, 0x80);
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, 0, 0x40);
-  HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, 1, 0x80);
+  /* FIFO RAM partitioned by the FIFO planner, the TX FIFOs are allocated in endpoint order */
+  HAL_PCDEx_SetRxFiFo(&hpcd_USB_OTG_FS, FIFO_RX_WORDS);
+  for (ep = 0; ep < FIFO_IN_ENDPOINTS; ep++)
+  {
+    HAL_PCDEx_SetTxFiFo(&hpcd_USB_OTG_FS, ep, fifo_tx_words[ep]);
+  }
   }
   return USBD_OK;
 }
@@ -137,9 +137,15 @@ __ALIGN_BEGIN uint8_t USBD_FS_DeviceDesc[USB_LEN_DEV_DESC] __ALIGN_END =
     0x00,                       /* bcdUSB */
 #endif
     0x02,
+#if (USBD_CDC_PORTS > 1) || (USBD_CDC_BULK == 1)
+    0xEF,                       /*bDeviceClass: Miscellaneous (composite device with IADs)*/
+    0x02,                       /*bDeviceSubClass: Common Class*/
+    0x01,                       /*bDeviceProtocol: Interface Association Descriptor*/
+#else
     0x02,                        /*bDeviceClass*/
     0x02,                       /*bDeviceSubClass*/
     0x00,                       /*bDeviceProtocol*/
+#endif
     USB_MAX_EP0_SIZE,          /*bMaxPacketSize*/
     LOBYTE(USBD_VID),           /*idVendor*/
     HIBYTE(USBD_VID),           /*idVendor*/